@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bars.h"
+#include "timedate.h"
+
+#define BARS_COLUMNS 7
+
+static const struct {
+    const char *name;
+    int64_t interval;
+} bar_sizes[] = {
+    { "5m", 5*60 },
+    { "1h", 60*60 },
+    { "4h", 4*60*60 },
+    { "1d", 24*60*60 },
+    { "1w", 7*24*60*60 },
+};
+
+/* seconds per bar of a bar size such as 1h, 0 if it isn't one */
+int64_t bars_interval(const char *name) {
+    size_t i;
+    
+    for (i = 0; i < sizeof(bar_sizes) / sizeof(bar_sizes[0]); i++) {
+        if (strcmp(name, bar_sizes[i].name) == 0) {
+            return bar_sizes[i].interval;
+        }
+    }
+    
+    return 0;
+}
+
+/* turns samples in order into bars of interval seconds counted from origin, in one pass over them: a bar's samples are read once
+   for its end, high, low and VWAP together. bars without samples are left out.
+   the API's volumes are 24 hour totals as of each sample, so a bar's volume is the one as of its close
+   and they weigh the prices for the VWAP. returns 1 on success */
+int8_t bars_resample(struct bars_t *bars, const int64_t *timestamp, const double *price, const double *volume, size_t length,
+                     int64_t origin, int64_t interval) {
+    size_t capacity;
+    size_t start;
+    size_t end;
+    int64_t bar;
+    int64_t bar_end;
+    double high;
+    double low;
+    double weighted;
+    double total;
+    double *columns;
+    
+    memset(bars, 0, sizeof(*bars));
+    bars->interval = interval;
+    if ((length == 0) || (interval <= 0)) {
+        return 1;
+    }
+    
+    /* at most one bar per sample and one per interval */
+    capacity = (timestamp[length - 1] - timestamp[0]) / interval + 2;
+    capacity = (capacity < length) ? capacity : length;
+    
+    /* all the columns in one block, the timestamps are as wide as the values */
+    columns = malloc(sizeof(double) * BARS_COLUMNS * capacity);
+    if (columns == NULL) {
+        fprintf(stderr, "error: malloc bars\n");
+        return 0;
+    }
+    bars->timestamp = (int64_t *) columns;
+    bars->open = columns + capacity;
+    bars->high = columns + capacity * 2;
+    bars->low = columns + capacity * 3;
+    bars->close = columns + capacity * 4;
+    bars->volume = columns + capacity * 5;
+    bars->vwap = columns + capacity * 6;
+    
+    for (start = 0; start < length; start = end) {
+        /* rounded down, also for samples before origin */
+        bar = (timestamp[start] - origin) / interval;
+        bar -= ((timestamp[start] - origin) % interval) < 0;
+        bar_end = origin + (bar + 1) * interval;
+        high = price[start];
+        low = price[start];
+        weighted = 0;
+        total = 0;
+        for (end = start; (end < length) && (timestamp[end] < bar_end); end++) {
+            high = (price[end] > high) ? price[end] : high;
+            low = (price[end] < low) ? price[end] : low;
+            weighted += price[end] * volume[end];
+            total += volume[end];
+        }
+        
+        bars->timestamp[bars->length] = bar_end - interval;
+        bars->open[bars->length] = price[start];
+        bars->high[bars->length] = high;
+        bars->low[bars->length] = low;
+        bars->close[bars->length] = price[end - 1];
+        bars->volume[bars->length] = volume[end - 1];
+        bars->vwap[bars->length] = (total > 0) ? weighted / total : price[end - 1];
+        bars->length++;
+    }
+    
+    return 1;
+}
+
+/* one tab separated line per bar: start date and time (UTC), open, high, low, close, volume and VWAP */
+void bars_print(FILE *out, const struct bars_t *bars) {
+    struct date_yyyymmdd_t *dates;
+    int64_t seconds;
+    size_t i;
+    
+    dates = malloc(sizeof(struct date_yyyymmdd_t) * (bars->length ? bars->length : 1));
+    if (dates == NULL) {
+        fprintf(stderr, "error: malloc bar dates\n");
+        return;
+    }
+    timestamps_to_dates(bars->timestamp, dates, bars->length);
+    
+    for (i = 0; i < bars->length; i++) {
+        seconds = bars->timestamp[i] % (24*60*60);
+        seconds += (seconds < 0) ? (24*60*60) : 0;
+        fprintf(out, "%04d-%02d-%02d %02d:%02d\t%f\t%f\t%f\t%f\t%f\t%f\n",
+                dates[i].year, dates[i].month, dates[i].day, (int) (seconds / (60*60)), (int) (seconds / 60 % 60),
+                bars->open[i], bars->high[i], bars->low[i], bars->close[i], bars->volume[i], bars->vwap[i]);
+    }
+    
+    free(dates);
+}
+
+void bars_free(struct bars_t *bars) {
+    /* the columns are one block that starts with the timestamps */
+    free(bars->timestamp);
+    memset(bars, 0, sizeof(*bars));
+}
\ No newline at end of file
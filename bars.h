@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/* open/high/low/close, volume and volume weighted average price bars of a fixed size, in columns */
+struct bars_t {
+    int64_t interval;           /* seconds per bar */
+    int64_t *timestamp;         /* where each bar starts */
+    double *open;
+    double *high;
+    double *low;
+    double *close;
+    double *volume;
+    double *vwap;
+    size_t length;
+};
+
+int64_t bars_interval(const char *name);
+int8_t bars_resample(struct bars_t *bars, const int64_t *timestamp, const double *price, const double *volume, size_t length,
+                     int64_t origin, int64_t interval);
+void bars_print(FILE *out, const struct bars_t *bars);
+void bars_free(struct bars_t *bars);
\ No newline at end of file
@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+
+/* samples of a column rounded up to fill whole CACHE_ALIGN blocks */
+static uint64_t cache_capacity(uint64_t count) {
+    uint64_t per_block = CACHE_ALIGN / sizeof(int64_t);
+    
+    return (count + per_block - 1) / per_block * per_block;
+}
+
+static size_t cache_file_size(uint64_t capacity) {
+    return sizeof(struct cache_header_t) + CACHE_COLUMNS * capacity * sizeof(int64_t);
+}
+
+/* maps the cache file at path. returns 1 on success, 0 if there's no usable cache */
+int8_t cache_open(struct cache_t *cache, const char *path) {
+    const struct cache_header_t *header;
+    const char *columns;
+    struct stat st;
+    int fd;
+    
+    memset(cache, 0, sizeof(*cache));
+    
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    if ((fstat(fd, &st) != 0) || ((size_t) st.st_size < sizeof(struct cache_header_t))) {
+        close(fd);
+        return 0;
+    }
+    
+    cache->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    /* the mapping stays valid after the file is closed */
+    close(fd);
+    if (cache->map == MAP_FAILED) {
+        cache->map = NULL;
+        return 0;
+    }
+    cache->map_size = st.st_size;
+    
+    header = cache->map;
+    if ((memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0) || (header->version != CACHE_VERSION) ||
+        (header->count > header->capacity) || (header->capacity != cache_capacity(header->capacity)) ||
+        (cache->map_size < cache_file_size(header->capacity))) {
+        fprintf(stderr, "warning: ignoring invalid cache %s\n", path);
+        cache_close(cache);
+        return 0;
+    }
+    
+    columns = (const char *) cache->map + sizeof(struct cache_header_t);
+    cache->header = header;
+    cache->timestamp = (const int64_t *) columns;
+    cache->price = (const double *) (columns + header->capacity * sizeof(int64_t));
+    cache->volume = (const double *) (columns + header->capacity * sizeof(int64_t) * 2);
+    cache->market_cap = (const double *) (columns + header->capacity * sizeof(int64_t) * 3);
+    
+    return 1;
+}
+
+/* whether the cache has the range in at least the given resolution. returns 1 if so */
+int8_t cache_covers(const struct cache_t *cache, int64_t begin, int64_t end, uint32_t resolution) {
+    return (cache->header != NULL) && (cache->header->count > 0) &&
+           (cache->header->range_begin <= begin) && (cache->header->range_end >= end) &&
+           (cache->header->resolution <= resolution);
+}
+
+/* whether the cache has the range from begin in at least the given resolution, up to somewhere before its end,
+   so that only the rest of it needs to be fetched. returns 1 if so */
+int8_t cache_covers_start(const struct cache_t *cache, int64_t begin, uint32_t resolution) {
+    return (cache->header != NULL) && (cache->header->count > 0) &&
+           (cache->header->range_begin <= begin) && (cache->header->resolution <= resolution);
+}
+
+/* finds the samples from begin to end, both included, by binary search over the timestamps */
+void cache_slice(const struct cache_t *cache, int64_t begin, int64_t end, size_t *first, size_t *count) {
+    size_t low = 0;
+    size_t high = cache->header->count;
+    size_t mid;
+    size_t last;
+    
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        if (cache->timestamp[mid] < begin) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    *first = low;
+    
+    high = cache->header->count;
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        if (cache->timestamp[mid] <= end) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    last = low;
+    
+    *count = last - *first;
+}
+
+/* writes a column and zeroes up to the capacity. returns 1 on success */
+static int8_t cache_write_column(FILE *file, const void *column, uint64_t count, uint64_t capacity) {
+    static const char zeros[CACHE_ALIGN];
+    uint64_t padding = (capacity - count) * sizeof(int64_t);
+    
+    if (fwrite(column, sizeof(int64_t), count, file) != count) {
+        return 0;
+    }
+    while (padding > 0) {
+        if (fwrite(zeros, 1, padding < sizeof(zeros) ? padding : sizeof(zeros), file) == 0) {
+            return 0;
+        }
+        padding -= padding < sizeof(zeros) ? padding : sizeof(zeros);
+    }
+    
+    return 1;
+}
+
+/* writes the columns to a cache file at path, header gives resolution, count and the range.
+   the file is replaced only once it's complete. returns 1 on success */
+int8_t cache_save(const char *path, const struct cache_header_t *header, const int64_t *timestamp,
+                  const double *price, const double *volume, const double *market_cap) {
+    struct cache_header_t out = *header;
+    char *tmp_path;
+    FILE *file;
+    int8_t ok;
+    
+    memcpy(out.magic, CACHE_MAGIC, sizeof(out.magic));
+    out.version = CACHE_VERSION;
+    /* room to append a few refreshes in place */
+    out.capacity = cache_capacity(out.count + out.count / 4);
+    out.first_timestamp = out.count ? timestamp[0] : 0;
+    out.last_timestamp = out.count ? timestamp[out.count - 1] : 0;
+    
+    tmp_path = malloc(strlen(path) + 5);
+    if (tmp_path == NULL) {
+        fprintf(stderr, "error: malloc cache path\n");
+        return 0;
+    }
+    sprintf(tmp_path, "%s.tmp", path);
+    
+    file = fopen(tmp_path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "warning: can't write cache %s\n", tmp_path);
+        free(tmp_path);
+        return 0;
+    }
+    
+    ok = (fwrite(&out, sizeof(out), 1, file) == 1) &&
+         cache_write_column(file, timestamp, out.count, out.capacity) &&
+         cache_write_column(file, price, out.count, out.capacity) &&
+         cache_write_column(file, volume, out.count, out.capacity) &&
+         cache_write_column(file, market_cap, out.count, out.capacity);
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    
+    if (ok && (rename(tmp_path, path) != 0)) {
+        ok = 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "warning: can't write cache %s\n", path);
+        remove(tmp_path);
+    }
+    free(tmp_path);
+    
+    return ok;
+}
+
+/* writes count samples of a column at index in the file, returns 1 on success */
+static int8_t cache_write_at(int fd, const struct cache_header_t *header, int column, uint64_t index, const void *data, size_t count) {
+    off_t offset = sizeof(struct cache_header_t) + (column * header->capacity + index) * sizeof(int64_t);
+    
+    return pwrite(fd, data, count * sizeof(int64_t), offset) == (ssize_t) (count * sizeof(int64_t));
+}
+
+/* keeps the first sample in each resolution long slot of time, packing the columns. returns how many are left */
+static size_t cache_downsample(int64_t **columns, size_t count, uint32_t resolution) {
+    size_t kept = 0;
+    size_t i;
+    int column;
+    
+    for (i = 0; i < count; i++) {
+        if ((kept > 0) && (columns[0][i] / resolution == columns[0][kept - 1] / resolution)) {
+            continue;
+        }
+        for (column = 0; column < CACHE_COLUMNS; column++) {
+            columns[column][kept] = columns[column][i];
+        }
+        kept++;
+    }
+    
+    return kept;
+}
+
+/* appends the samples that come after the cache's last timestamp and extends its range to range_end.
+   they're written in place when the columns have room, the header last so that the old count stays valid until then,
+   otherwise the file is rewritten with room to spare. samples in another resolution than the cache's (e.g. a tail
+   shorter than a day comes in 5 minutes) are rewritten along with it, all in the coarser of the two, so that the file
+   doesn't mix them. the cache is mapped again. returns 1 on success */
+int8_t cache_append(struct cache_t *cache, const char *path, int64_t range_end, uint32_t resolution, const int64_t *timestamp,
+                    const double *price, const double *volume, const double *market_cap, size_t count) {
+    struct cache_header_t header = *cache->header;
+    int64_t *columns[CACHE_COLUMNS];
+    const void *sources[CACHE_COLUMNS];
+    size_t skip = 0;
+    size_t total;
+    uint8_t rewrite;
+    int column;
+    int8_t ok;
+    int fd;
+    
+    while ((skip < count) && (header.count > 0) && (timestamp[skip] <= header.last_timestamp)) {
+        skip++;
+    }
+    count -= skip;
+    total = header.count + count;
+    rewrite = (count > 0) && (header.count > 0) && (resolution != header.resolution);
+    
+    sources[0] = &timestamp[skip];
+    sources[1] = &price[skip];
+    sources[2] = &volume[skip];
+    sources[3] = &market_cap[skip];
+    
+    if (header.resolution < resolution) {
+        header.resolution = resolution;
+    }
+    if (header.range_end < range_end) {
+        header.range_end = range_end;
+    }
+    
+    if ((total <= header.capacity) && !rewrite) {
+        fd = open(path, O_WRONLY);
+        if (fd < 0) {
+            fprintf(stderr, "warning: can't write cache %s\n", path);
+            return 0;
+        }
+        ok = 1;
+        for (column = 0; (column < CACHE_COLUMNS) && ok; column++) {
+            ok = cache_write_at(fd, &header, column, header.count, sources[column], count);
+        }
+        if (count > 0) {
+            header.last_timestamp = timestamp[skip + count - 1];
+            if (header.count == 0) {
+                header.first_timestamp = timestamp[skip];
+            }
+        }
+        header.count = total;
+        if (ok) {
+            ok = pwrite(fd, &header, sizeof(header), 0) == sizeof(header);
+        }
+        if (close(fd) != 0) {
+            ok = 0;
+        }
+        if (!ok) {
+            fprintf(stderr, "warning: can't write cache %s\n", path);
+        }
+    } else {
+        /* both the old columns and the new samples into one place to be saved */
+        for (column = 0; column < CACHE_COLUMNS; column++) {
+            columns[column] = malloc(total * sizeof(int64_t));
+        }
+        ok = (columns[0] != NULL) && (columns[1] != NULL) && (columns[2] != NULL) && (columns[3] != NULL);
+        if (!ok) {
+            fprintf(stderr, "error: malloc cache columns\n");
+        } else {
+            memcpy(columns[0], cache->timestamp, header.count * sizeof(int64_t));
+            memcpy(columns[1], cache->price, header.count * sizeof(int64_t));
+            memcpy(columns[2], cache->volume, header.count * sizeof(int64_t));
+            memcpy(columns[3], cache->market_cap, header.count * sizeof(int64_t));
+            for (column = 0; column < CACHE_COLUMNS; column++) {
+                memcpy(&columns[column][header.count], sources[column], count * sizeof(int64_t));
+            }
+            header.count = rewrite ? cache_downsample(columns, total, header.resolution) : total;
+            ok = cache_save(path, &header, columns[0], (double *) columns[1], (double *) columns[2], (double *) columns[3]);
+        }
+        for (column = 0; column < CACHE_COLUMNS; column++) {
+            free(columns[column]);
+        }
+    }
+    
+    cache_close(cache);
+    if (cache_open(cache, path) == 0) {
+        return 0;
+    }
+    
+    return ok;
+}
+
+void cache_close(struct cache_t *cache) {
+    if (cache->map != NULL) {
+        munmap(cache->map, cache->map_size);
+    }
+    memset(cache, 0, sizeof(*cache));
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* binary cache of a coin's series, one file per coin and currency:
+   a header and then the columns, each starting on a CACHE_ALIGN boundary, so that the file can be mapped and used as is */
+#define CACHE_MAGIC "MMSERIES"
+#define CACHE_VERSION 1
+#define CACHE_ALIGN 64
+#define CACHE_COLUMNS 4
+
+struct cache_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t resolution;        /* seconds between samples */
+    uint64_t count;             /* samples in the columns */
+    uint64_t capacity;          /* samples the columns have room for, so that they can be appended to in place */
+    int64_t first_timestamp;
+    int64_t last_timestamp;
+    int64_t range_begin;        /* the range that was queried to get the samples, there may be none right at its ends */
+    int64_t range_end;
+};
+
+/* a mapped cache file. the columns point into the mapping and are valid until cache_close */
+struct cache_t {
+    void *map;
+    size_t map_size;
+    const struct cache_header_t *header;
+    const int64_t *timestamp;
+    const double *price;
+    const double *volume;
+    const double *market_cap;
+};
+
+int8_t cache_open(struct cache_t *cache, const char *path);
+int8_t cache_covers(const struct cache_t *cache, int64_t begin, int64_t end, uint32_t resolution);
+int8_t cache_covers_start(const struct cache_t *cache, int64_t begin, uint32_t resolution);
+void cache_slice(const struct cache_t *cache, int64_t begin, int64_t end, size_t *first, size_t *count);
+int8_t cache_save(const char *path, const struct cache_header_t *header, const int64_t *timestamp,
+                  const double *price, const double *volume, const double *market_cap);
+int8_t cache_append(struct cache_t *cache, const char *path, int64_t range_end, uint32_t resolution, const int64_t *timestamp,
+                    const double *price, const double *volume, const double *market_cap, size_t count);
+void cache_close(struct cache_t *cache);
\ No newline at end of file
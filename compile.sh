@@ -1 +1 @@
-rm moneymaker; gcc -Wall -lm -lcurl timedate.c curl_helpers.c json.c main.c -o moneymaker
\ No newline at end of file
+rm moneymaker; gcc -Wall -lm -lcurl timedate.c curl_helpers.c json.c series.c cache.c bars.c main.c -o moneymaker
\ No newline at end of file
@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdint.h>
+#include <time.h>
 
 #include <curl/curl.h>
 
@@ -9,51 +11,860 @@
 
 #include "curl_helpers.h"
 
+static struct MemoryStruct memory_pool[MEMORY_POOL_SIZE];
+static uint8_t memory_pool_count = 0;
+
+/* takes the smallest pooled buffer of at least capacity bytes, or the biggest one grown to it */
+int memory_acquire(struct MemoryStruct *chunk, size_t capacity) {
+    uint8_t best = 0;
+    uint8_t i;
+    
+    memset(chunk, 0, sizeof(*chunk));
+    
+    if (memory_pool_count > 0) {
+        for (i = 1; i < memory_pool_count; i++) {
+            if (memory_pool[best].capacity < capacity) {
+                if (memory_pool[i].capacity > memory_pool[best].capacity) {
+                    best = i;
+                }
+            } else if ((memory_pool[i].capacity >= capacity) && (memory_pool[i].capacity < memory_pool[best].capacity)) {
+                best = i;
+            }
+        }
+        chunk->memory = memory_pool[best].memory;
+        chunk->capacity = memory_pool[best].capacity;
+        memory_pool[best] = memory_pool[--memory_pool_count];
+    }
+    
+    if (memory_reserve(chunk, capacity) == 0) {
+        return 0;
+    }
+    chunk->memory[0] = 0;
+    
+    return 1;
+}
+
+/* makes room for at least capacity bytes, growing geometrically */
+int memory_reserve(struct MemoryStruct *chunk, size_t capacity) {
+    size_t new_capacity = chunk->capacity ? chunk->capacity : MEMORY_MIN_CAPACITY;
+    char *ptr;
+    
+    if ((capacity <= chunk->capacity) && (chunk->memory != NULL)) {
+        return 1;
+    }
+    while (new_capacity < capacity) {
+        new_capacity *= 2;
+    }
+    
+    ptr = realloc(chunk->memory, new_capacity);
+    if (!ptr) {
+        fprintf(stderr, "not enough memory (realloc returned NULL)\n");
+        return 0;
+    }
+    chunk->memory = ptr;
+    chunk->capacity = new_capacity;
+    
+    return 1;
+}
+
+/* gives the buffer back to the pool, or frees it if the pool is full */
+void memory_release(struct MemoryStruct *chunk) {
+    if (chunk->memory != NULL) {
+        if (memory_pool_count < MEMORY_POOL_SIZE) {
+            memory_pool[memory_pool_count].memory = chunk->memory;
+            memory_pool[memory_pool_count].capacity = chunk->capacity;
+            memory_pool_count++;
+        } else {
+            free(chunk->memory);
+        }
+    }
+    chunk->memory = NULL;
+    chunk->size = 0;
+    chunk->capacity = 0;
+}
+
+void memory_pool_cleanup(void) {
+    while (memory_pool_count > 0) {
+        free(memory_pool[--memory_pool_count].memory);
+    }
+}
+
+/* pre-sizes the buffer from Content-Length when the whole body is going to be kept in it */
+static size_t HeaderCallback(char *buffer, size_t size, size_t nitems, void *userp) {
+    size_t realsize = size * nitems;
+    struct MemoryStruct *mem = (struct MemoryStruct *)userp;
+    char line[64];
+    unsigned long long length;
+    
+    /* a compressed body's length is less than what will be written, but still a start */
+    if ((mem->consume == NULL) && (realsize > 15) && (realsize < sizeof(line)) && (strncasecmp(buffer, "content-length:", 15) == 0)) {
+        memcpy(line, buffer, realsize);
+        line[realsize] = 0;
+        length = strtoull(&line[15], NULL, 10);
+        if ((length > 0) && (length <= MEMORY_PRESIZE_MAX)) {
+            memory_reserve(mem, mem->size + length + 1);
+        }
+    }
+    
+    return realsize;
+}
+
 /*static*/ size_t WriteMemoryCallback(void *contents, size_t size, size_t nmemb, void *userp) {
     size_t realsize = size * nmemb;
+    size_t used;
     struct MemoryStruct *mem = (struct MemoryStruct *)userp;
     
-    /* hardcode max request size? */
-    char *ptr = realloc(mem->memory, mem->size + realsize + 1);
-    if (!ptr) {
-        printf("not enough memory (realloc returned NULL)\n");
+    if (memory_reserve(mem, mem->size + realsize + 1) == 0) {
         return 0;
     }
     
-    mem->memory = ptr;
     memcpy(&(mem->memory[mem->size]), contents, realsize);
     mem->size += realsize;
     mem->memory[mem->size] = 0;
     
+    if (mem->consume != NULL) {
+        used = mem->consume(mem->memory, mem->size, mem->consume_data);
+        if (used == (size_t) -1) {
+            return 0;
+        }
+        /* keep only what wasn't used, including the terminator */
+        memmove(mem->memory, &(mem->memory[used]), mem->size - used + 1);
+        mem->size -= used;
+    }
+    
     return realsize;
 }
 
-int request(char *req, struct MemoryStruct *chunk) {
+/* a transfer waiting for its turn or running */
+struct transfer_t {
     CURL *curl_handle;
-    CURLcode res;
+    char *req;
+    char *key;                  /* file name for recording or replaying, NULL if it isn't */
+    FILE *record;               /* where the body is written as it comes, when recording */
+    struct MemoryStruct *chunk;
+    fetch_done_t done;
+    void *done_data;
+    int32_t priority;
+    uint64_t seq;               /* order of adding, for equal priorities */
+    uint8_t attempt;
+    uint8_t delivered;          /* some of the body went to chunk, so it can't be retried */
+    int64_t not_before;         /* ms, when backing off */
+    struct transfer_t *next;
+};
+
+struct fetch_t {
+    CURLM *multi_handle;
+    CURLSH *share;
+    uint32_t max_concurrent;
+    uint32_t running;
+    uint64_t seq;
+    /* ready to start, a heap by priority */
+    struct transfer_t **ready;
+    uint32_t ready_length;
+    uint32_t ready_capacity;
+    /* backing off after a failure, until their not_before */
+    struct transfer_t *delayed;
+    /* running, so that they can be found to be cancelled */
+    struct transfer_t *active;
+    /* finished, kept to reuse their curl handles */
+    struct transfer_t *idle;
+    /* token bucket of requests that may be started, 0 rate for no limit */
+    double tokens;
+    double rate;                /* tokens per ms */
+    int64_t refilled_at;
+    int64_t blocked_until;      /* told to slow down by the server */
+    uint32_t timeout;           /* seconds to connect or to go without data */
+    /* directory responses are saved to, or served from instead of the network */
+    char *record_dir;
+    char *replay_dir;
+};
+
+/* curl_global_init and curl_global_cleanup once however many contexts there are */
+static uint32_t fetch_count = 0;
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
-    curl_global_init(CURL_GLOBAL_ALL);
+struct fetch_t *fetch_init(uint32_t max_concurrent, uint32_t requests_per_minute) {
+    struct fetch_t *fetch;
+    
+    fetch = calloc(1, sizeof(struct fetch_t));
+    if (fetch == NULL) {
+        fprintf(stderr, "error: malloc fetch\n");
+        return NULL;
+    }
+    
+    if (fetch_count++ == 0) {
+        curl_global_init(CURL_GLOBAL_ALL);
+        srand(time(NULL));
+    }
+    
+    fetch->max_concurrent = max_concurrent ? max_concurrent : 1;
+    fetch->rate = requests_per_minute / (60.0 * 1000.0);
+    fetch->tokens = FETCH_BURST;
+    fetch->refilled_at = now_ms();
+    fetch->timeout = FETCH_STALL_TIMEOUT;
     
-    curl_handle = curl_easy_init();
+    fetch->share = curl_share_init();
+    fetch->multi_handle = curl_multi_init();
+    if ((fetch->share == NULL) || (fetch->multi_handle == NULL)) {
+        fprintf(stderr, "error: curl init\n");
+        fetch_cleanup(fetch);
+        return NULL;
+    }
+    
+    curl_share_setopt(fetch->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(fetch->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(fetch->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
     
-    curl_easy_setopt(curl_handle, CURLOPT_URL, req);
+    return fetch;
+}
+
+static void transfer_free(struct transfer_t *transfer) {
+    if (transfer->curl_handle != NULL) {
+        curl_easy_cleanup(transfer->curl_handle);
+    }
+    free(transfer->req);
+    free(transfer->key);
+    free(transfer);
+}
+
+void fetch_cleanup(struct fetch_t *fetch) {
+    struct transfer_t *transfer;
     
-    curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
+    if (fetch == NULL) {
+        return;
+    }
+    /* the handles have to let go of the share before it can be cleaned up */
+    while (fetch->ready_length > 0) {
+        transfer_free(fetch->ready[--fetch->ready_length]);
+    }
+    free(fetch->ready);
+    while (fetch->active != NULL) {
+        transfer = fetch->active;
+        fetch->active = transfer->next;
+        curl_multi_remove_handle(fetch->multi_handle, transfer->curl_handle);
+        if (transfer->record != NULL) {
+            fclose(transfer->record);
+        }
+        transfer_free(transfer);
+    }
+    while (fetch->delayed != NULL) {
+        transfer = fetch->delayed;
+        fetch->delayed = transfer->next;
+        transfer_free(transfer);
+    }
+    while (fetch->idle != NULL) {
+        transfer = fetch->idle;
+        fetch->idle = transfer->next;
+        transfer_free(transfer);
+    }
+    if (fetch->multi_handle != NULL) {
+        curl_multi_cleanup(fetch->multi_handle);
+    }
+    if (fetch->share != NULL) {
+        curl_share_cleanup(fetch->share);
+    }
+    free(fetch->record_dir);
+    free(fetch->replay_dir);
+    free(fetch);
     
-    curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *)chunk);
+    if (--fetch_count == 0) {
+        curl_global_cleanup();
+    }
+}
+
+/* lower priority first, then in the order they were added */
+static int transfer_before(struct transfer_t *a, struct transfer_t *b) {
+    if (a->priority != b->priority) {
+        return a->priority < b->priority;
+    }
+    return a->seq < b->seq;
+}
 
-    curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, "libcurl-agent/1.0");
+static int ready_push(struct fetch_t *fetch, struct transfer_t *transfer) {
+    struct transfer_t **ready;
+    struct transfer_t *parent;
+    uint32_t i;
     
-    res = curl_easy_perform(curl_handle);
+    if (fetch->ready_length == fetch->ready_capacity) {
+        ready = realloc(fetch->ready, sizeof(struct transfer_t *) * (fetch->ready_capacity ? fetch->ready_capacity * 2 : 16));
+        if (ready == NULL) {
+            fprintf(stderr, "error: malloc ready queue\n");
+            return 1;
+        }
+        fetch->ready = ready;
+        fetch->ready_capacity = fetch->ready_capacity ? fetch->ready_capacity * 2 : 16;
+    }
     
-    if(res != CURLE_OK) {
-    fprintf(stderr, "curl_easy_perform() failed: %s\n",
-            curl_easy_strerror(res));
+    /* sift up */
+    for (i = fetch->ready_length++; i > 0; i = (i - 1) / 2) {
+        parent = fetch->ready[(i - 1) / 2];
+        if (!transfer_before(transfer, parent)) {
+            break;
+        }
+        fetch->ready[i] = parent;
     }
+    fetch->ready[i] = transfer;
+    
+    return 0;
+}
 
-    curl_easy_cleanup(curl_handle);
+static struct transfer_t *ready_pop(struct fetch_t *fetch) {
+    struct transfer_t *top = fetch->ready[0];
+    struct transfer_t *last = fetch->ready[--fetch->ready_length];
+    uint32_t i = 0;
+    uint32_t child;
     
-    curl_global_cleanup();
+    /* sift down */
+    while ((child = 2 * i + 1) < fetch->ready_length) {
+        if ((child + 1 < fetch->ready_length) && transfer_before(fetch->ready[child + 1], fetch->ready[child])) {
+            child++;
+        }
+        if (!transfer_before(fetch->ready[child], last)) {
+            break;
+        }
+        fetch->ready[i] = fetch->ready[child];
+        i = child;
+    }
+    fetch->ready[i] = last;
     
+    return top;
+}
+
+/* error responses aren't passed on to chunk, the transfer is either retried or reported as failed */
+static size_t TransferWriteCallback(void *contents, size_t size, size_t nmemb, void *userp) {
+    struct transfer_t *transfer = (struct transfer_t *)userp;
+    long status = 0;
+    
+    curl_easy_getinfo(transfer->curl_handle, CURLINFO_RESPONSE_CODE, &status);
+    if (status >= 400) {
+        return size * nmemb;
+    }
+    
+    if ((transfer->record != NULL) && (fwrite(contents, size, nmemb, transfer->record) != nmemb)) {
+        fprintf(stderr, "%s: recording failed\n", transfer->req);
+        fclose(transfer->record);
+        transfer->record = NULL;
+    }
+    
+    transfer->delivered = 1;
+    return WriteMemoryCallback(contents, size, nmemb, transfer->chunk);
+}
+
+/* saves responses to dir, each in a file named by the key it was added with */
+int fetch_record(struct fetch_t *fetch, const char *dir) {
+    free(fetch->record_dir);
+    fetch->record_dir = strdup(dir);
+    if (fetch->record_dir == NULL) {
+        fprintf(stderr, "error: malloc record_dir\n");
+        return 1;
+    }
     return 0;
+}
+
+/* serves responses from the files fetch_record saved in dir, without any network */
+int fetch_replay(struct fetch_t *fetch, const char *dir) {
+    free(fetch->replay_dir);
+    fetch->replay_dir = strdup(dir);
+    if (fetch->replay_dir == NULL) {
+        fprintf(stderr, "error: malloc replay_dir\n");
+        return 1;
+    }
+    return 0;
+}
+
+void fetch_timeout(struct fetch_t *fetch, uint32_t seconds) {
+    fetch->timeout = seconds;
+}
+
+/* dir/key, or NULL */
+static char *fetch_path(const char *dir, const char *key) {
+    char *path;
+    
+    path = malloc(strlen(dir) + strlen(key) + 2);
+    if (path == NULL) {
+        fprintf(stderr, "error: malloc path\n");
+        return NULL;
+    }
+    sprintf(path, "%s/%s", dir, key);
+    
+    return path;
+}
+
+/* returns 0 on success, 1 if the transfer couldn't be queued */
+int fetch_add(struct fetch_t *fetch, const char *req, const char *key, struct MemoryStruct *chunk, int32_t priority, fetch_done_t done, void *done_data) {
+    struct transfer_t *transfer;
+    
+    if (fetch->idle != NULL) {
+        transfer = fetch->idle;
+        fetch->idle = transfer->next;
+    } else {
+        transfer = calloc(1, sizeof(struct transfer_t));
+        if (transfer == NULL) {
+            fprintf(stderr, "error: malloc transfer\n");
+            return 1;
+        }
+        transfer->curl_handle = curl_easy_init();
+        if (transfer->curl_handle == NULL) {
+            fprintf(stderr, "error: curl init\n");
+            free(transfer);
+            return 1;
+        }
+        
+        /* options that are the same for every request */
+        curl_easy_setopt(transfer->curl_handle, CURLOPT_SHARE, fetch->share);
+        
+        curl_easy_setopt(transfer->curl_handle, CURLOPT_PRIVATE, (void *)transfer);
+        
+        curl_easy_setopt(transfer->curl_handle, CURLOPT_WRITEFUNCTION, TransferWriteCallback);
+        
+        curl_easy_setopt(transfer->curl_handle, CURLOPT_WRITEDATA, (void *)transfer);
+        
+        curl_easy_setopt(transfer->curl_handle, CURLOPT_HEADERFUNCTION, HeaderCallback);
+
+        curl_easy_setopt(transfer->curl_handle, CURLOPT_USERAGENT, "libcurl-agent/1.0");
+        
+        curl_easy_setopt(transfer->curl_handle, CURLOPT_TCP_KEEPALIVE, 1L);
+        
+        /* a server that takes the connection and never answers fails the transfer with CURLE_OPERATION_TIMEDOUT,
+           instead of holding up everything that waits on it. less than a byte per second counts as no data */
+        curl_easy_setopt(transfer->curl_handle, CURLOPT_CONNECTTIMEOUT, (long) fetch->timeout);
+        
+        curl_easy_setopt(transfer->curl_handle, CURLOPT_LOW_SPEED_LIMIT, 1L);
+        
+        curl_easy_setopt(transfer->curl_handle, CURLOPT_LOW_SPEED_TIME, (long) fetch->timeout);
+        
+        /* ask for every encoding libcurl was built with (gzip, deflate, brotli...). it inflates as the data
+           comes in and the write callback only ever sees the json, a piece at a time */
+        curl_easy_setopt(transfer->curl_handle, CURLOPT_ACCEPT_ENCODING, "");
+    }
+    
+    transfer->req = strdup(req);
+    transfer->key = (key != NULL) ? strdup(key) : NULL;
+    if ((transfer->req == NULL) || ((key != NULL) && (transfer->key == NULL))) {
+        fprintf(stderr, "error: malloc req\n");
+        free(transfer->req);
+        transfer->req = NULL;
+        free(transfer->key);
+        transfer->key = NULL;
+        transfer->next = fetch->idle;
+        fetch->idle = transfer;
+        return 1;
+    }
+    transfer->chunk = chunk;
+    transfer->done = done;
+    transfer->done_data = done_data;
+    transfer->priority = priority;
+    transfer->seq = fetch->seq++;
+    transfer->attempt = 0;
+    transfer->next = NULL;
+    
+    if (ready_push(fetch, transfer) != 0) {
+        free(transfer->req);
+        transfer->req = NULL;
+        free(transfer->key);
+        transfer->key = NULL;
+        transfer->next = fetch->idle;
+        fetch->idle = transfer;
+        return 1;
+    }
+    
+    return 0;
+}
+
+/* the body is written to path.part while it comes, so that an interrupted transfer doesn't leave a bad recording */
+static void rename_recording(const char *path, int failed) {
+    char *part;
+    
+    part = malloc(strlen(path) + 6);
+    if (part == NULL) {
+        fprintf(stderr, "error: malloc path\n");
+        return;
+    }
+    sprintf(part, "%s.part", path);
+    if (failed) {
+        remove(part);
+    } else if (rename(part, path) != 0) {
+        fprintf(stderr, "%s: saving the recording failed\n", path);
+    }
+    free(part);
+}
+
+/* recycles the transfer and tells whoever added it that it's done */
+static void transfer_finish(struct fetch_t *fetch, struct transfer_t *transfer, int failed) {
+    struct MemoryStruct *chunk = transfer->chunk;
+    fetch_done_t done = transfer->done;
+    void *done_data = transfer->done_data;
+    char *path;
+    
+    /* a recording is only kept when the whole body made it */
+    if (transfer->record != NULL) {
+        fclose(transfer->record);
+        transfer->record = NULL;
+        path = fetch_path(fetch->record_dir, transfer->key);
+        if (path != NULL) {
+            rename_recording(path, failed);
+            free(path);
+        }
+    }
+    
+    /* recycle first so that the callback can add transfers of its own */
+    free(transfer->req);
+    transfer->req = NULL;
+    free(transfer->key);
+    transfer->key = NULL;
+    transfer->next = fetch->idle;
+    fetch->idle = transfer;
+    
+    done(chunk, failed, done_data);
+}
+
+/* feeds a recorded body through the same callbacks as one coming from the network */
+static void transfer_replay(struct fetch_t *fetch, struct transfer_t *transfer) {
+    char buffer[CURL_MAX_WRITE_SIZE];
+    char *path;
+    FILE *file = NULL;
+    size_t length;
+    int failed = 1;
+    
+    path = (transfer->key != NULL) ? fetch_path(fetch->replay_dir, transfer->key) : NULL;
+    if (path != NULL) {
+        file = fopen(path, "rb");
+        if (file == NULL) {
+            fprintf(stderr, "%s: no recorded response in %s\n", transfer->req, path);
+        }
+        free(path);
+    }
+    
+    if (file != NULL) {
+        failed = 0;
+        while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            if (WriteMemoryCallback(buffer, 1, length, transfer->chunk) != length) {
+                failed = 1;
+                break;
+            }
+        }
+        if (ferror(file)) {
+            fprintf(stderr, "%s: reading the recorded response failed\n", transfer->req);
+            failed = 1;
+        }
+        fclose(file);
+    }
+    
+    transfer_finish(fetch, transfer, failed);
+}
+
+static void fetch_refill(struct fetch_t *fetch, int64_t now) {
+    if (fetch->rate > 0) {
+        fetch->tokens += (now - fetch->refilled_at) * fetch->rate;
+        if (fetch->tokens > FETCH_BURST) {
+            fetch->tokens = FETCH_BURST;
+        }
+    }
+    fetch->refilled_at = now;
+}
+
+/* opens path.part for the body to be written to as it comes, replacing what a failed attempt left */
+static void transfer_record(struct fetch_t *fetch, struct transfer_t *transfer) {
+    char *path;
+    
+    path = fetch_path(fetch->record_dir, transfer->key);
+    if (path == NULL) {
+        return;
+    }
+    path = realloc(path, strlen(path) + 6);
+    if (path == NULL) {
+        fprintf(stderr, "error: malloc path\n");
+        return;
+    }
+    strcat(path, ".part");
+    
+    transfer->record = fopen(path, "wb");
+    if (transfer->record == NULL) {
+        fprintf(stderr, "%s: can't record to %s\n", transfer->req, path);
+    }
+    free(path);
+}
+
+/* starts ready transfers while there are free slots and the rate allows.
+   returns how many ms until something could be started, for polling */
+static int fetch_start_ready(struct fetch_t *fetch) {
+    struct transfer_t *transfer;
+    struct transfer_t **link;
+    int64_t now = now_ms();
+    int64_t wait = 1000;
+    
+    /* done backing off */
+    for (link = &fetch->delayed; *link != NULL; ) {
+        transfer = *link;
+        if (transfer->not_before <= now) {
+            *link = transfer->next;
+            transfer->next = NULL;
+            if (ready_push(fetch, transfer) != 0) {
+                transfer->next = *link;
+                *link = transfer;
+                break;
+            }
+        } else {
+            if (transfer->not_before - now < wait) {
+                wait = transfer->not_before - now;
+            }
+            link = &transfer->next;
+        }
+    }
+    
+    /* nothing goes over the network, so neither slots nor the rate apply */
+    if (fetch->replay_dir != NULL) {
+        while (fetch->ready_length > 0) {
+            transfer_replay(fetch, ready_pop(fetch));
+        }
+        return wait;
+    }
+    
+    fetch_refill(fetch, now);
+    
+    while ((fetch->ready_length > 0) && (fetch->running < fetch->max_concurrent)) {
+        if (fetch->blocked_until > now) {
+            if (fetch->blocked_until - now < wait) {
+                wait = fetch->blocked_until - now;
+            }
+            break;
+        }
+        if ((fetch->rate > 0) && (fetch->tokens < 1.0)) {
+            if ((1.0 - fetch->tokens) / fetch->rate < wait) {
+                wait = (1.0 - fetch->tokens) / fetch->rate + 1;
+            }
+            break;
+        }
+        if (fetch->rate > 0) {
+            fetch->tokens -= 1.0;
+        }
+        
+        transfer = ready_pop(fetch);
+        transfer->delivered = 0;
+        
+        if ((fetch->record_dir != NULL) && (transfer->key != NULL)) {
+            transfer_record(fetch, transfer);
+        }
+        
+        curl_easy_setopt(transfer->curl_handle, CURLOPT_URL, transfer->req);
+        
+        curl_easy_setopt(transfer->curl_handle, CURLOPT_HEADERDATA, (void *)transfer->chunk);
+        
+        curl_multi_add_handle(fetch->multi_handle, transfer->curl_handle);
+        fetch->running++;
+        transfer->next = fetch->active;
+        fetch->active = transfer;
+    }
+    
+    return wait;
+}
+
+/* whether a failed transfer is worth another try: the server was busy or the connection broke before any data */
+static int transfer_retryable(struct transfer_t *transfer, CURLcode res, long status) {
+    if (transfer->delivered || (transfer->attempt >= FETCH_MAX_RETRIES)) {
+        return 0;
+    }
+    if ((status == 429) || (status == 502) || (status == 503) || (status == 504)) {
+        return 1;
+    }
+    return (res == CURLE_GOT_NOTHING) || (res == CURLE_RECV_ERROR) || (res == CURLE_SEND_ERROR) || (res == CURLE_OPERATION_TIMEDOUT);
+}
+
+/* exponential backoff with jitter, so that retries of many transfers don't come back all at once.
+   the server's Retry-After wins when it's given */
+static int64_t transfer_backoff(struct transfer_t *transfer, curl_off_t retry_after) {
+    int64_t delay = (int64_t) FETCH_BACKOFF_MS << transfer->attempt;
+    
+    if (delay > FETCH_BACKOFF_MAX_MS) {
+        delay = FETCH_BACKOFF_MAX_MS;
+    }
+    delay = delay / 2 + rand() % (delay / 2 + 1);
+    
+    if (retry_after > 0) {
+        delay = (int64_t) retry_after * 1000 + rand() % 1000;
+    }
+    
+    return delay;
+}
+
+/* takes a transfer that's done off the running ones */
+static void active_remove(struct fetch_t *fetch, struct transfer_t *transfer) {
+    struct transfer_t **link;
+    
+    for (link = &fetch->active; *link != NULL; link = &(*link)->next) {
+        if (*link == transfer) {
+            *link = transfer->next;
+            break;
+        }
+    }
+    transfer->next = NULL;
+    fetch->running--;
+}
+
+/* drops a transfer without calling its done callback, a recording it started isn't kept */
+static void transfer_cancel(struct fetch_t *fetch, struct transfer_t *transfer) {
+    char *path;
+    
+    if (transfer->record != NULL) {
+        fclose(transfer->record);
+        transfer->record = NULL;
+        path = fetch_path(fetch->record_dir, transfer->key);
+        if (path != NULL) {
+            rename_recording(path, 1);
+            free(path);
+        }
+    }
+    free(transfer->req);
+    transfer->req = NULL;
+    free(transfer->key);
+    transfer->key = NULL;
+    transfer->next = fetch->idle;
+    fetch->idle = transfer;
+}
+
+/* cancels the transfers added with done_data, wherever they are: waiting, backing off or running.
+   their done callback isn't called, so whatever they write to can be freed right after */
+void fetch_cancel(struct fetch_t *fetch, void *done_data) {
+    struct transfer_t *transfer;
+    struct transfer_t **link;
+    uint32_t length;
+    uint32_t i;
+    
+    /* the heap is built again from the ones that stay, pushing never writes past what was already read */
+    length = fetch->ready_length;
+    fetch->ready_length = 0;
+    for (i = 0; i < length; i++) {
+        transfer = fetch->ready[i];
+        if (transfer->done_data == done_data) {
+            transfer_cancel(fetch, transfer);
+        } else {
+            ready_push(fetch, transfer);
+        }
+    }
+    for (link = &fetch->delayed; *link != NULL; ) {
+        transfer = *link;
+        if (transfer->done_data == done_data) {
+            *link = transfer->next;
+            transfer_cancel(fetch, transfer);
+        } else {
+            link = &transfer->next;
+        }
+    }
+    for (link = &fetch->active; *link != NULL; ) {
+        transfer = *link;
+        if (transfer->done_data == done_data) {
+            curl_multi_remove_handle(fetch->multi_handle, transfer->curl_handle);
+            active_remove(fetch, transfer);
+            transfer_cancel(fetch, transfer);
+        } else {
+            link = &transfer->next;
+        }
+    }
+}
+
+/* whether there are transfers left to run, waiting or backing off */
+int fetch_pending(struct fetch_t *fetch) {
+    return (fetch->running > 0) || (fetch->ready_length > 0) || (fetch->delayed != NULL);
+}
+
+/* one round of the transfers: starts what may be started, moves the running ones along and calls the done callbacks
+   of the ones that finished, which may add more transfers. then waits until there's network activity or something
+   is due, up to timeout_ms (-1 for no limit), or until one of extra_fds is ready, which their revents tell */
+void fetch_step(struct fetch_t *fetch, struct curl_waitfd *extra_fds, unsigned int num_extra_fds, int timeout_ms) {
+    struct transfer_t *transfer;
+    CURLMsg *msg;
+    CURLcode res;
+    curl_off_t retry_after;
+    long status;
+    int64_t delay;
+    int still_running;
+    int msgs_left;
+    int wait;
+    int failed;
+    
+    fetch_start_ready(fetch);
+    curl_multi_perform(fetch->multi_handle, &still_running);
+    
+    while ((msg = curl_multi_info_read(fetch->multi_handle, &msgs_left)) != NULL) {
+        if (msg->msg != CURLMSG_DONE) {
+            continue;
+        }
+        res = msg->data.result;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&transfer);
+        status = 0;
+        curl_easy_getinfo(transfer->curl_handle, CURLINFO_RESPONSE_CODE, &status);
+        retry_after = 0;
+        curl_easy_getinfo(transfer->curl_handle, CURLINFO_RETRY_AFTER, &retry_after);
+        curl_multi_remove_handle(fetch->multi_handle, transfer->curl_handle);
+        active_remove(fetch, transfer);
+        
+        if (transfer_retryable(transfer, res, status)) {
+            delay = transfer_backoff(transfer, retry_after);
+            fprintf(stderr, "%s: %s, retrying in %.1f s\n", transfer->req,
+                    (status >= 400) ? "server busy" : curl_easy_strerror(res), delay / 1000.0);
+            if (transfer->record != NULL) {
+                fclose(transfer->record);
+                transfer->record = NULL;
+            }
+            transfer->attempt++;
+            transfer->not_before = now_ms() + delay;
+            /* being rate limited applies to every request, not just this one */
+            if ((status == 429) && (transfer->not_before > fetch->blocked_until)) {
+                fetch->blocked_until = transfer->not_before;
+            }
+            transfer->next = fetch->delayed;
+            fetch->delayed = transfer;
+            continue;
+        }
+        
+        failed = (res != CURLE_OK) || (status >= 400);
+        if (res != CURLE_OK) {
+            fprintf(stderr, "curl transfer of %s failed: %s\n",
+                    transfer->req, curl_easy_strerror(res));
+        } else if (status >= 400) {
+            fprintf(stderr, "%s: HTTP %ld\n", transfer->req, status);
+        }
+        
+        transfer_finish(fetch, transfer, failed);
+    }
+    
+    wait = fetch_start_ready(fetch);
+    
+    if (fetch_pending(fetch) || (num_extra_fds > 0)) {
+        if (!fetch_pending(fetch) || ((timeout_ms >= 0) && (timeout_ms < wait))) {
+            wait = timeout_ms;
+        }
+        curl_multi_poll(fetch->multi_handle, extra_fds, num_extra_fds, wait > 0 ? wait : 1, NULL);
+    }
+}
+
+/* runs the queued transfers until all of them are done, by priority, at most max_concurrent at a time and
+   within the request rate. each one's done callback is called as soon as it finishes and may add more transfers */
+void fetch_run(struct fetch_t *fetch) {
+    do {
+        fetch_step(fetch, NULL, 0, -1);
+    } while (fetch_pending(fetch));
+}
+
+static void request_done(struct MemoryStruct *chunk, int failed, void *done_data) {
+    (void) chunk;
+    *(int *)done_data = failed;
+}
+
+/* blocking single request. returns 0 on success, 1 if the transfer failed */
+int request(struct fetch_t *fetch, char *req, struct MemoryStruct *chunk) {
+    int failed = 1;
+    
+    if (fetch_add(fetch, req, NULL, chunk, 0, request_done, &failed) != 0) {
+        return 1;
+    }
+    fetch_run(fetch);
+    
+    return failed;
 }
\ No newline at end of file
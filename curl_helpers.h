@@ -2,10 +2,67 @@
 
 #include <stdint.h>
 
+/* response buffers start this big and double when full */
+#define MEMORY_MIN_CAPACITY (64 * 1024)
+/* Content-Length above this isn't trusted for pre-sizing, the buffer grows as the data comes instead */
+#define MEMORY_PRESIZE_MAX (64 * 1024 * 1024)
+/* released buffers kept around for the next request */
+#define MEMORY_POOL_SIZE 4
+
 struct MemoryStruct {
   char *memory;
   size_t size;
+  size_t capacity;  /* bytes allocated for memory, 0 if there's no buffer */
+  /* optional, called after every write with the buffered data. returns how much of it was used up
+     and can be dropped from memory, or (size_t) -1 to abort the transfer */
+  size_t (*consume)(const char *data, size_t size, void *consume_data);
+  void *consume_data;
 };
 
+/* buffers are taken from the pool and given back to it, instead of being malloced and freed per request */
+int memory_acquire(struct MemoryStruct *chunk, size_t capacity);
+int memory_reserve(struct MemoryStruct *chunk, size_t capacity);
+void memory_release(struct MemoryStruct *chunk);
+void memory_pool_cleanup(void);
+
+/* default cap on transfers running at the same time */
+#define FETCH_MAX_CONCURRENT 8
+/* default request rate, about what the public API allows. requests beyond the burst wait for their turn */
+#define FETCH_REQUESTS_PER_MINUTE 30
+#define FETCH_BURST 5
+/* retries of a transfer when the server is busy (429, 5xx) or the connection broke before any data,
+   backing off exponentially from FETCH_BACKOFF_MS up to FETCH_BACKOFF_MAX_MS unless told how long with Retry-After */
+#define FETCH_MAX_RETRIES 6
+#define FETCH_BACKOFF_MS 1000
+#define FETCH_BACKOFF_MAX_MS 60000
+/* default seconds a transfer may take to connect or go without any data before it's given up on, and retried.
+   there's no limit on the whole transfer, as a long range is a big body */
+#define FETCH_STALL_TIMEOUT 30
+
+/* long-lived state for requests: the curl handles and what's shared across requests
+   (connections, DNS cache and TLS sessions), so only the first request to a host pays for the setup */
+struct fetch_t;
+
+/* called when a transfer is done, failed is 1 if it didn't complete or got an error status.
+   error responses aren't written to chunk */
+typedef void (*fetch_done_t)(struct MemoryStruct *chunk, int failed, void *done_data);
+
+/* requests_per_minute 0 for no limit */
+struct fetch_t *fetch_init(uint32_t max_concurrent, uint32_t requests_per_minute);
+void fetch_cleanup(struct fetch_t *fetch);
+/* key names the file the response is recorded to or replayed from, NULL for neither. lower priority goes first */
+int fetch_add(struct fetch_t *fetch, const char *req, const char *key, struct MemoryStruct *chunk, int32_t priority, fetch_done_t done, void *done_data);
+/* record every response with a key to dir, or replay them all from there without any network */
+int fetch_record(struct fetch_t *fetch, const char *dir);
+int fetch_replay(struct fetch_t *fetch, const char *dir);
+/* seconds for the transfers added after it to connect or to go without data, see FETCH_STALL_TIMEOUT */
+void fetch_timeout(struct fetch_t *fetch, uint32_t seconds);
+void fetch_run(struct fetch_t *fetch);
+/* for running the transfers from an event loop of one's own, one round at a time */
+struct curl_waitfd;
+int fetch_pending(struct fetch_t *fetch);
+void fetch_step(struct fetch_t *fetch, struct curl_waitfd *extra_fds, unsigned int num_extra_fds, int timeout_ms);
+void fetch_cancel(struct fetch_t *fetch, void *done_data);
+
 /*static*/ size_t WriteMemoryCallback(void *contents, size_t size, size_t nmemb, void *userp);
-int request(char *req, struct MemoryStruct *chunk);
\ No newline at end of file
+int request(struct fetch_t *fetch, char *req, struct MemoryStruct *chunk);
\ No newline at end of file
@@ -86,11 +86,6 @@ static unsigned char hex_value (json_char c)
    }
 }
 
-static int would_overflow (json_int_t value, json_char b)
-{
-   return ((JSON_INT_MAX - (b - '0')) / 10 ) < value;
-}
-
 typedef struct
 {
    size_t used_memory;
@@ -225,834 +220,2825 @@ static int new_value (json_state * state,
    return 1;
 }
 
-#define whitespace \
-   case '\n': ++ state.cur_line;  state.cur_col = 0; /* FALLTHRU */ \
-   case ' ': /* FALLTHRU */ case '\t': /* FALLTHRU */ case '\r'
+/* Structural scanner
+ *
+ * Classifies 32 bytes at a time so that runs of whitespace, number
+ * characters and string contents can be skipped in bulk.  AVX2 or SSE2 is
+ * picked at runtime on x86, other targets use the scalar version.
+ */
 
-#define string_add(b)  \
-   do { if (!state.first_pass) string [string_length] = b;  ++ string_length; } while (0);
+typedef struct
+{
+   uint32_t space;       /* whitespace */
+   uint32_t newline;
+   uint32_t number;      /* digits, signs, `.`, `e` and `E` */
+   uint32_t structural;  /* `{`, `}`, `[`, `]`, `:` and `,` */
+   uint32_t string;      /* `"` and `\` */
 
-#define line_and_col \
-   state.cur_line, state.cur_col
+} json_scan_masks;
 
-static const long
-   flag_next             = 1 << 0,
-   flag_reproc           = 1 << 1,
-   flag_need_comma       = 1 << 2,
-   flag_seek_value       = 1 << 3,
-   flag_escaped          = 1 << 4,
-   flag_string           = 1 << 5,
-   flag_need_colon       = 1 << 6,
-   flag_done             = 1 << 7,
-   flag_num_negative     = 1 << 8,
-   flag_num_zero         = 1 << 9,
-   flag_num_e            = 1 << 10,
-   flag_num_e_got_sign   = 1 << 11,
-   flag_num_e_negative   = 1 << 12,
-   flag_line_comment     = 1 << 13,
-   flag_block_comment    = 1 << 14,
-   flag_num_got_decimal  = 1 << 15;
+#define scan_block_size 32
 
-json_value * json_parse_ex (json_settings * settings,
-                            const json_char * json,
-                            size_t length,
-                            char * error_buf)
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+   #define JSON_SCAN_X86 1
+   #include <immintrin.h>
+#endif
+
+static int trailing_zeros (uint32_t mask)
 {
-   char error [json_error_max];
-   const json_char * end;
-   json_value * top, * root, * alloc = 0;
-   json_state state = { 0 };
-   long flags = 0;
-   int num_digits = 0;
-   double num_e = 0, num_fraction = 0;
+   #if defined(__GNUC__)
+      return __builtin_ctz (mask);
+   #else
+      int zeros = 0;
 
-   /* Skip UTF-8 BOM
-    */
-   if (length >= 3 && ((unsigned char) json [0]) == 0xEF
-                   && ((unsigned char) json [1]) == 0xBB
-                   && ((unsigned char) json [2]) == 0xBF)
-   {
-      json += 3;
-      length -= 3;
-   }
+      for (; ! (mask & 1); mask >>= 1)
+         ++ zeros;
 
-   error[0] = '\0';
-   end = (json + length);
+      return zeros;
+   #endif
+}
 
-   memcpy (&state.settings, settings, sizeof (json_settings));
+static int count_ones (uint32_t mask)
+{
+   #if defined(__GNUC__)
+      return __builtin_popcount (mask);
+   #else
+      int ones = 0;
 
-   if (!state.settings.mem_alloc)
-      state.settings.mem_alloc = default_alloc;
+      for (; mask; mask &= mask - 1)
+         ++ ones;
 
-   if (!state.settings.mem_free)
-      state.settings.mem_free = default_free;
+      return ones;
+   #endif
+}
 
-   for (state.first_pass = 1; state.first_pass >= 0; -- state.first_pass)
-   {
-      json_uchar uchar;
-      unsigned char uc_b1, uc_b2, uc_b3, uc_b4;
-      json_char * string = 0;
-      unsigned int string_length = 0;
+static int highest_one (uint32_t mask)
+{
+   int bit = 0;
 
-      top = root = 0;
-      flags = flag_seek_value;
+   #if defined(__GNUC__)
+      bit = 31 - __builtin_clz (mask);
+   #else
+      while (mask >>= 1)
+         ++ bit;
+   #endif
 
-      state.cur_line = 1;
+   return bit;
+}
 
-      for (state.ptr = json ;; ++ state.ptr)
+static void scan_block_scalar (const json_char * ptr, json_scan_masks * masks)
+{
+   uint32_t bit;
+   int i;
+
+   memset (masks, 0, sizeof (*masks));
+
+   for (i = 0; i < scan_block_size; ++ i)
+   {
+      bit = (uint32_t) 1 << i;
+
+      switch (ptr [i])
       {
-         json_char b = (state.ptr == end ? 0 : *state.ptr);
+         case '\n':
+            masks->newline |= bit;  /* FALLTHRU */
+         case ' ': case '\t': case '\r':
+            masks->space |= bit;
+            break;
 
-         if (flags & flag_string)
-         {
-            if (!b)
-            {  sprintf (error, "%u:%u: Unexpected EOF in string", line_and_col);
-               goto e_failed;
-            }
+         case '0': case '1': case '2': case '3': case '4':
+         case '5': case '6': case '7': case '8': case '9':
+         case '-': case '+': case '.': case 'e': case 'E':
+            masks->number |= bit;
+            break;
 
-            if (string_length > UINT_MAX - 8)
-               goto e_overflow;
+         case '{': case '}': case '[': case ']': case ':': case ',':
+            masks->structural |= bit;
+            break;
 
-            if (flags & flag_escaped)
-            {
-               flags &= ~ flag_escaped;
+         case '"': case '\\':
+            masks->string |= bit;
+            break;
 
-               switch (b)
-               {
-                  case 'b':  string_add ('\b');  break;
-                  case 'f':  string_add ('\f');  break;
-                  case 'n':  string_add ('\n');  break;
-                  case 'r':  string_add ('\r');  break;
-                  case 't':  string_add ('\t');  break;
-                  case 'u':
+         default:
+            break;
+      };
+   }
+}
 
-                    if (end - state.ptr <= 4 ||
-                        (uc_b1 = hex_value (*++ state.ptr)) == 0xFF ||
-                        (uc_b2 = hex_value (*++ state.ptr)) == 0xFF ||
-                        (uc_b3 = hex_value (*++ state.ptr)) == 0xFF ||
-                        (uc_b4 = hex_value (*++ state.ptr)) == 0xFF)
-                    {
-                        sprintf (error, "%u:%u: Invalid character value `%c`", line_and_col, b);
-                        goto e_failed;
-                    }
+#ifdef JSON_SCAN_X86
 
-                    uc_b1 = (uc_b1 << 4) | uc_b2;
-                    uc_b2 = (uc_b3 << 4) | uc_b4;
-                    uchar = (uc_b1 << 8) | uc_b2;
+__attribute__ ((target ("sse2")))
+static void scan_half_sse2 (const json_char * ptr, json_scan_masks * masks, int shift)
+{
+   __m128i in = _mm_loadu_si128 ((const __m128i *) ptr);
 
-                    if ((uchar & 0xF800) == 0xD800) {
-                        json_uchar uchar2;
+   #define eq(c) _mm_cmpeq_epi8 (in, _mm_set1_epi8 (c))
+   #define mask(v) (((uint32_t) _mm_movemask_epi8 (v)) << shift)
 
-                        if (end - state.ptr <= 6 || (*++ state.ptr) != '\\' || (*++ state.ptr) != 'u' ||
-                            (uc_b1 = hex_value (*++ state.ptr)) == 0xFF ||
-                            (uc_b2 = hex_value (*++ state.ptr)) == 0xFF ||
-                            (uc_b3 = hex_value (*++ state.ptr)) == 0xFF ||
-                            (uc_b4 = hex_value (*++ state.ptr)) == 0xFF)
-                        {
-                            sprintf (error, "%u:%u: Invalid character value `%c`", line_and_col, b);
-                            goto e_failed;
-                        }
+   __m128i newline = eq ('\n');
+   __m128i digit = _mm_and_si128 (_mm_cmpgt_epi8 (in, _mm_set1_epi8 ('0' - 1)),
+                                  _mm_cmplt_epi8 (in, _mm_set1_epi8 ('9' + 1)));
 
-                        uc_b1 = (uc_b1 << 4) | uc_b2;
-                        uc_b2 = (uc_b3 << 4) | uc_b4;
-                        uchar2 = (uc_b1 << 8) | uc_b2;
+   masks->newline |= mask (newline);
 
-                        uchar = 0x010000 | ((uchar & 0x3FF) << 10) | (uchar2 & 0x3FF);
-                    }
+   masks->space |= mask (_mm_or_si128 (_mm_or_si128 (newline, eq (' ')),
+                                            _mm_or_si128 (eq ('\t'), eq ('\r'))));
 
-                    if (sizeof (json_char) >= sizeof (json_uchar) || (uchar <= 0x7F))
-                    {
-                       string_add ((json_char) uchar);
-                       break;
-                    }
+   masks->number |= mask (_mm_or_si128 (_mm_or_si128 (digit, eq ('-')),
+                            _mm_or_si128 (_mm_or_si128 (eq ('+'), eq ('.')),
+                                          _mm_or_si128 (eq ('e'), eq ('E')))));
 
-                    if (uchar <= 0x7FF)
-                    {
-                        if (state.first_pass)
-                           string_length += 2;
-                        else
-                        {  string [string_length ++] = 0xC0 | (uchar >> 6);
-                           string [string_length ++] = 0x80 | (uchar & 0x3F);
-                        }
+   masks->structural |= mask (_mm_or_si128 (_mm_or_si128 (_mm_or_si128 (eq ('{'), eq ('}')),
+                                                          _mm_or_si128 (eq ('['), eq (']'))),
+                                            _mm_or_si128 (eq (':'), eq (','))));
 
-                        break;
-                    }
+   masks->string |= mask (_mm_or_si128 (eq ('"'), eq ('\\')));
 
-                    if (uchar <= 0xFFFF) {
-                        if (state.first_pass)
-                           string_length += 3;
-                        else
-                        {  string [string_length ++] = 0xE0 | (uchar >> 12);
-                           string [string_length ++] = 0x80 | ((uchar >> 6) & 0x3F);
-                           string [string_length ++] = 0x80 | (uchar & 0x3F);
-                        }
+   #undef mask
+   #undef eq
+}
 
-                        break;
-                    }
+__attribute__ ((target ("sse2")))
+static void scan_block_sse2 (const json_char * ptr, json_scan_masks * masks)
+{
+   memset (masks, 0, sizeof (*masks));
 
-                    if (state.first_pass)
-                       string_length += 4;
-                    else
-                    {  string [string_length ++] = 0xF0 | (uchar >> 18);
-                       string [string_length ++] = 0x80 | ((uchar >> 12) & 0x3F);
-                       string [string_length ++] = 0x80 | ((uchar >> 6) & 0x3F);
-                       string [string_length ++] = 0x80 | (uchar & 0x3F);
-                    }
+   scan_half_sse2 (ptr, masks, 0);
+   scan_half_sse2 (ptr + 16, masks, 16);
+}
 
-                    break;
+__attribute__ ((target ("avx2")))
+static void scan_block_avx2 (const json_char * ptr, json_scan_masks * masks)
+{
+   __m256i in = _mm256_loadu_si256 ((const __m256i *) ptr);
 
-                  default:
-                     string_add (b);
-               };
+   #define eq(c) _mm256_cmpeq_epi8 (in, _mm256_set1_epi8 (c))
+   #define mask(v) ((uint32_t) _mm256_movemask_epi8 (v))
 
-               continue;
-            }
+   __m256i newline = eq ('\n');
+   __m256i digit = _mm256_and_si256 (_mm256_cmpgt_epi8 (in, _mm256_set1_epi8 ('0' - 1)),
+                                     _mm256_cmpgt_epi8 (_mm256_set1_epi8 ('9' + 1), in));
 
-            if (b == '\\')
-            {
-               flags |= flag_escaped;
-               continue;
-            }
+   masks->newline = mask (newline);
 
-            if (b == '"')
-            {
-               if (!state.first_pass)
-                  string [string_length] = 0;
+   masks->space = mask (_mm256_or_si256 (_mm256_or_si256 (newline, eq (' ')),
+                                              _mm256_or_si256 (eq ('\t'), eq ('\r'))));
 
-               flags &= ~ flag_string;
-               string = 0;
+   masks->number = mask (_mm256_or_si256 (_mm256_or_si256 (digit, eq ('-')),
+                           _mm256_or_si256 (_mm256_or_si256 (eq ('+'), eq ('.')),
+                                            _mm256_or_si256 (eq ('e'), eq ('E')))));
 
-               switch (top->type)
-               {
-                  case json_string:
+   masks->structural = mask (_mm256_or_si256 (_mm256_or_si256 (_mm256_or_si256 (eq ('{'), eq ('}')),
+                                                               _mm256_or_si256 (eq ('['), eq (']'))),
+                                              _mm256_or_si256 (eq (':'), eq (','))));
 
-                     top->u.string.length = string_length;
-                     flags |= flag_next;
+   masks->string = mask (_mm256_or_si256 (eq ('"'), eq ('\\')));
 
-                     break;
+   #undef mask
+   #undef eq
+}
 
-                  case json_object:
+#endif
 
-                     if (state.first_pass) {
-                        json_char **chars = (json_char **) &top->u.object.values;
-                        chars[0] += string_length + 1;
-                     }
-                     else
-                     {
-                        top->u.object.values [top->u.object.length].name
-                           = (json_char *) top->_reserved.object_mem;
+static void scan_block_init (const json_char * ptr, json_scan_masks * masks);
 
-                        top->u.object.values [top->u.object.length].name_length
-                           = string_length;
+static void (* scan_block) (const json_char * ptr, json_scan_masks * masks) = scan_block_init;
 
-                        (*(json_char **) &top->_reserved.object_mem) += string_length + 1;
-                     }
+/* picks the implementation on first use */
+static void scan_block_init (const json_char * ptr, json_scan_masks * masks)
+{
+   #ifdef JSON_SCAN_X86
+      __builtin_cpu_init ();
 
-                     flags |= flag_seek_value | flag_need_colon;
-                     continue;
+      if (__builtin_cpu_supports ("avx2"))
+         scan_block = scan_block_avx2;
+      else if (__builtin_cpu_supports ("sse2"))
+         scan_block = scan_block_sse2;
+      else
+         scan_block = scan_block_scalar;
+   #else
+      scan_block = scan_block_scalar;
+   #endif
 
-                  default:
-                     break;
-               };
-            }
-            else
-            {
-               string_add (b);
-               continue;
-            }
-         }
+   scan_block (ptr, masks);
+}
 
-         if (state.settings.settings & json_enable_comments)
-         {
-            if (flags & (flag_line_comment | flag_block_comment))
-            {
-               if (flags & flag_line_comment)
-               {
-                  if (b == '\r' || b == '\n' || !b)
-                  {
-                     flags &= ~ flag_line_comment;
-                     -- state.ptr;  /* so null can be reproc'd */
-                  }
+/* Classifies [ptr, ptr + 32), with anything at or past `end` classified as
+ * nothing at all.
+ */
+static void scan (const json_char * ptr, const json_char * end, json_scan_masks * masks)
+{
+   json_char block [scan_block_size];
 
-                  continue;
-               }
+   if (end - ptr >= scan_block_size)
+   {
+      scan_block (ptr, masks);
+      return;
+   }
 
-               if (flags & flag_block_comment)
-               {
-                  if (!b)
-                  {  sprintf (error, "%u:%u: Unexpected EOF in block comment", line_and_col);
-                     goto e_failed;
-                  }
+   memset (block, 0, sizeof (block));
+   memcpy (block, ptr, end - ptr);
 
-                  if (b == '*' && state.ptr < (end - 1) && state.ptr [1] == '/')
-                  {
-                     flags &= ~ flag_block_comment;
-                     ++ state.ptr;  /* skip closing sequence */
-                  }
+   scan_block (block, masks);
+}
+
+typedef struct
+{
+   const json_char * base;   /* blocks are 32-byte steps from here */
+   const json_char * block;  /* the block classified in masks, if any */
+   json_scan_masks masks;
+
+} json_scanner;
+
+static void scanner_init (json_scanner * scanner, const json_char * base)
+{
+   scanner->base = base;
+   scanner->block = 0;
+}
+
+/* The classification of the block holding ptr, each block being classified
+ * only once however many tokens it holds.  Sets *offset to ptr's bit.
+ */
+static const json_scan_masks * scanner_at (json_scanner * scanner,
+                                           const json_char * ptr,
+                                           const json_char * end,
+                                           int * offset)
+{
+   const json_char * block = ptr - ((size_t) (ptr - scanner->base) % scan_block_size);
+
+   if (block != scanner->block)
+   {
+      scanner->block = block;
+      scan (block, end, &scanner->masks);
+   }
+
+   *offset = (int) (ptr - block);
+   return &scanner->masks;
+}
+
+static const json_char * scan_number_end (json_scanner * scanner,
+                                          const json_char * ptr,
+                                          const json_char * end)
+{
+   const json_scan_masks * masks;
+   uint32_t run;
+   int offset;
+
+   while (ptr < end)
+   {
+      masks = scanner_at (scanner, ptr, end, &offset);
+
+      if ((run = (~ masks->number) >> offset))
+         return ptr + trailing_zeros (run);
+
+      ptr += scan_block_size - offset;
+   }
+
+   return end;
+}
+
+/* first `"` or `\` at or after ptr, or end */
+static const json_char * scan_string_special (json_scanner * scanner,
+                                              const json_char * ptr,
+                                              const json_char * end)
+{
+   const json_scan_masks * masks;
+   uint32_t special;
+   int offset;
+
+   while (ptr < end)
+   {
+      masks = scanner_at (scanner, ptr, end, &offset);
+
+      if ((special = masks->string >> offset))
+         return ptr + trailing_zeros (special);
+
+      ptr += scan_block_size - offset;
+   }
+
+   return end;
+}
+
+/* Skips whitespace, adding the newlines skipped to *lines and pointing
+ * *line_start after the last of them.
+ */
+static const json_char * scan_whitespace_end (json_scanner * scanner,
+                                              const json_char * ptr,
+                                              const json_char * end,
+                                              unsigned int * lines,
+                                              const json_char ** line_start)
+{
+   const json_scan_masks * masks;
+   uint32_t not_space, newlines;
+   int offset, run;
+
+   while (ptr < end)
+   {
+      masks = scanner_at (scanner, ptr, end, &offset);
+
+      not_space = ~ (masks->space >> offset);
+      run = not_space ? trailing_zeros (not_space) : scan_block_size;
+
+      newlines = masks->newline >> offset;
+
+      if (run < scan_block_size)
+         newlines &= ((uint32_t) 1 << run) - 1;
+
+      if (newlines)
+      {
+         *lines += count_ones (newlines);
+         *line_start = ptr + highest_one (newlines) + 1;
+      }
+
+      if (offset + run < scan_block_size)
+         return ptr + run;
+
+      ptr += run;
+   }
+
+   return end;
+}
+
+/* Number conversion
+ *
+ * Digits are accumulated into a 64-bit decimal mantissa (eight at a time
+ * where possible) and the result is mantissa * 10^exponent, rounded
+ * correctly: exactly when both fit in a double (Clinger's fast path), with
+ * the Eisel-Lemire algorithm otherwise, and with strtod as the fallback for
+ * the rare inputs neither can decide.
+ */
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+   #define JSON_SWAR_DIGITS 1
+#endif
+
+static int is_eight_digits (const json_char * ptr)
+{
+   #ifdef JSON_SWAR_DIGITS
+      uint64_t val;
+      memcpy (&val, ptr, sizeof (val));
+
+      return ! (((val + 0x4646464646464646ULL) | (val - 0x3030303030303030ULL))
+                  & 0x8080808080808080ULL);
+   #else
+      (void)ptr;
+      return 0;
+   #endif
+}
+
+static uint32_t parse_eight_digits (const json_char * ptr)
+{
+   uint64_t val;
+   memcpy (&val, ptr, sizeof (val));
+
+   val -= 0x3030303030303030ULL;
+   val = (val * 10) + (val >> 8);
+   val = (((val & 0x000000FF000000FFULL) * 0x000F424000000064ULL)
+            + (((val >> 16) & 0x000000FF000000FFULL) * 0x0000271000000001ULL)) >> 32;
+
+   return (uint32_t) val;
+}
+
+/* Adds the digits at *pptr to *mantissa while it stays below 10^18.  Returns
+ * how many digits were added; the rest are skipped and *truncated is set
+ * if any of them was not a zero.
+ */
+static int accumulate_digits (const json_char ** pptr, const json_char * end,
+                              uint64_t * mantissa, int * truncated)
+{
+   const json_char * ptr = *pptr;
+   uint64_t m = *mantissa;
+   int added = 0;
+
+   while ((end - ptr) >= 8 && m < 100000000000ULL && is_eight_digits (ptr))
+   {
+      m = (m * 100000000) + parse_eight_digits (ptr);
+      ptr += 8;
+      added += 8;
+   }
+
+   for (; ptr < end && isdigit ((unsigned char) *ptr); ++ ptr)
+   {
+      if (m < 1000000000000000000ULL)
+      {
+         m = (m * 10) + (*ptr - '0');
+         ++ added;
+      }
+      else if (*ptr != '0')
+      {
+         *truncated = 1;
+      }
+   }
+
+   *pptr = ptr;
+   *mantissa = m;
+
+   return added;
+}
+
+/* 5^q normalized to 128 bits for q in [pow5_min, pow5_max]: truncated for
+ * q >= 0, the reciprocal rounded up for q < 0.
+ */
+#define pow5_min -64
+#define pow5_max 64
+
+static const uint64_t pow5_128 [pow5_max - pow5_min + 1][2] =
+{
+   { 0xA87FEA27A539E9A5ULL, 0x3F2398D747B36224ULL },  /* 5^-64 */
+   { 0xD29FE4B18E88640EULL, 0x8EEC7F0D19A03AADULL },  /* 5^-63 */
+   { 0x83A3EEEEF9153E89ULL, 0x1953CF68300424ACULL },  /* 5^-62 */
+   { 0xA48CEAAAB75A8E2BULL, 0x5FA8C3423C052DD7ULL },  /* 5^-61 */
+   { 0xCDB02555653131B6ULL, 0x3792F412CB06794DULL },  /* 5^-60 */
+   { 0x808E17555F3EBF11ULL, 0xE2BBD88BBEE40BD0ULL },  /* 5^-59 */
+   { 0xA0B19D2AB70E6ED6ULL, 0x5B6ACEAEAE9D0EC4ULL },  /* 5^-58 */
+   { 0xC8DE047564D20A8BULL, 0xF245825A5A445275ULL },  /* 5^-57 */
+   { 0xFB158592BE068D2EULL, 0xEED6E2F0F0D56712ULL },  /* 5^-56 */
+   { 0x9CED737BB6C4183DULL, 0x55464DD69685606BULL },  /* 5^-55 */
+   { 0xC428D05AA4751E4CULL, 0xAA97E14C3C26B886ULL },  /* 5^-54 */
+   { 0xF53304714D9265DFULL, 0xD53DD99F4B3066A8ULL },  /* 5^-53 */
+   { 0x993FE2C6D07B7FABULL, 0xE546A8038EFE4029ULL },  /* 5^-52 */
+   { 0xBF8FDB78849A5F96ULL, 0xDE98520472BDD033ULL },  /* 5^-51 */
+   { 0xEF73D256A5C0F77CULL, 0x963E66858F6D4440ULL },  /* 5^-50 */
+   { 0x95A8637627989AADULL, 0xDDE7001379A44AA8ULL },  /* 5^-49 */
+   { 0xBB127C53B17EC159ULL, 0x5560C018580D5D52ULL },  /* 5^-48 */
+   { 0xE9D71B689DDE71AFULL, 0xAAB8F01E6E10B4A6ULL },  /* 5^-47 */
+   { 0x9226712162AB070DULL, 0xCAB3961304CA70E8ULL },  /* 5^-46 */
+   { 0xB6B00D69BB55C8D1ULL, 0x3D607B97C5FD0D22ULL },  /* 5^-45 */
+   { 0xE45C10C42A2B3B05ULL, 0x8CB89A7DB77C506AULL },  /* 5^-44 */
+   { 0x8EB98A7A9A5B04E3ULL, 0x77F3608E92ADB242ULL },  /* 5^-43 */
+   { 0xB267ED1940F1C61CULL, 0x55F038B237591ED3ULL },  /* 5^-42 */
+   { 0xDF01E85F912E37A3ULL, 0x6B6C46DEC52F6688ULL },  /* 5^-41 */
+   { 0x8B61313BBABCE2C6ULL, 0x2323AC4B3B3DA015ULL },  /* 5^-40 */
+   { 0xAE397D8AA96C1B77ULL, 0xABEC975E0A0D081AULL },  /* 5^-39 */
+   { 0xD9C7DCED53C72255ULL, 0x96E7BD358C904A21ULL },  /* 5^-38 */
+   { 0x881CEA14545C7575ULL, 0x7E50D64177DA2E54ULL },  /* 5^-37 */
+   { 0xAA242499697392D2ULL, 0xDDE50BD1D5D0B9E9ULL },  /* 5^-36 */
+   { 0xD4AD2DBFC3D07787ULL, 0x955E4EC64B44E864ULL },  /* 5^-35 */
+   { 0x84EC3C97DA624AB4ULL, 0xBD5AF13BEF0B113EULL },  /* 5^-34 */
+   { 0xA6274BBDD0FADD61ULL, 0xECB1AD8AEACDD58EULL },  /* 5^-33 */
+   { 0xCFB11EAD453994BAULL, 0x67DE18EDA5814AF2ULL },  /* 5^-32 */
+   { 0x81CEB32C4B43FCF4ULL, 0x80EACF948770CED7ULL },  /* 5^-31 */
+   { 0xA2425FF75E14FC31ULL, 0xA1258379A94D028DULL },  /* 5^-30 */
+   { 0xCAD2F7F5359A3B3EULL, 0x096EE45813A04330ULL },  /* 5^-29 */
+   { 0xFD87B5F28300CA0DULL, 0x8BCA9D6E188853FCULL },  /* 5^-28 */
+   { 0x9E74D1B791E07E48ULL, 0x775EA264CF55347EULL },  /* 5^-27 */
+   { 0xC612062576589DDAULL, 0x95364AFE032A819EULL },  /* 5^-26 */
+   { 0xF79687AED3EEC551ULL, 0x3A83DDBD83F52205ULL },  /* 5^-25 */
+   { 0x9ABE14CD44753B52ULL, 0xC4926A9672793543ULL },  /* 5^-24 */
+   { 0xC16D9A0095928A27ULL, 0x75B7053C0F178294ULL },  /* 5^-23 */
+   { 0xF1C90080BAF72CB1ULL, 0x5324C68B12DD6339ULL },  /* 5^-22 */
+   { 0x971DA05074DA7BEEULL, 0xD3F6FC16EBCA5E04ULL },  /* 5^-21 */
+   { 0xBCE5086492111AEAULL, 0x88F4BB1CA6BCF585ULL },  /* 5^-20 */
+   { 0xEC1E4A7DB69561A5ULL, 0x2B31E9E3D06C32E6ULL },  /* 5^-19 */
+   { 0x9392EE8E921D5D07ULL, 0x3AFF322E62439FD0ULL },  /* 5^-18 */
+   { 0xB877AA3236A4B449ULL, 0x09BEFEB9FAD487C3ULL },  /* 5^-17 */
+   { 0xE69594BEC44DE15BULL, 0x4C2EBE687989A9B4ULL },  /* 5^-16 */
+   { 0x901D7CF73AB0ACD9ULL, 0x0F9D37014BF60A11ULL },  /* 5^-15 */
+   { 0xB424DC35095CD80FULL, 0x538484C19EF38C95ULL },  /* 5^-14 */
+   { 0xE12E13424BB40E13ULL, 0x2865A5F206B06FBAULL },  /* 5^-13 */
+   { 0x8CBCCC096F5088CBULL, 0xF93F87B7442E45D4ULL },  /* 5^-12 */
+   { 0xAFEBFF0BCB24AAFEULL, 0xF78F69A51539D749ULL },  /* 5^-11 */
+   { 0xDBE6FECEBDEDD5BEULL, 0xB573440E5A884D1CULL },  /* 5^-10 */
+   { 0x89705F4136B4A597ULL, 0x31680A88F8953031ULL },  /* 5^-9 */
+   { 0xABCC77118461CEFCULL, 0xFDC20D2B36BA7C3EULL },  /* 5^-8 */
+   { 0xD6BF94D5E57A42BCULL, 0x3D32907604691B4DULL },  /* 5^-7 */
+   { 0x8637BD05AF6C69B5ULL, 0xA63F9A49C2C1B110ULL },  /* 5^-6 */
+   { 0xA7C5AC471B478423ULL, 0x0FCF80DC33721D54ULL },  /* 5^-5 */
+   { 0xD1B71758E219652BULL, 0xD3C36113404EA4A9ULL },  /* 5^-4 */
+   { 0x83126E978D4FDF3BULL, 0x645A1CAC083126EAULL },  /* 5^-3 */
+   { 0xA3D70A3D70A3D70AULL, 0x3D70A3D70A3D70A4ULL },  /* 5^-2 */
+   { 0xCCCCCCCCCCCCCCCCULL, 0xCCCCCCCCCCCCCCCDULL },  /* 5^-1 */
+   { 0x8000000000000000ULL, 0x0000000000000000ULL },  /* 5^0 */
+   { 0xA000000000000000ULL, 0x0000000000000000ULL },  /* 5^1 */
+   { 0xC800000000000000ULL, 0x0000000000000000ULL },  /* 5^2 */
+   { 0xFA00000000000000ULL, 0x0000000000000000ULL },  /* 5^3 */
+   { 0x9C40000000000000ULL, 0x0000000000000000ULL },  /* 5^4 */
+   { 0xC350000000000000ULL, 0x0000000000000000ULL },  /* 5^5 */
+   { 0xF424000000000000ULL, 0x0000000000000000ULL },  /* 5^6 */
+   { 0x9896800000000000ULL, 0x0000000000000000ULL },  /* 5^7 */
+   { 0xBEBC200000000000ULL, 0x0000000000000000ULL },  /* 5^8 */
+   { 0xEE6B280000000000ULL, 0x0000000000000000ULL },  /* 5^9 */
+   { 0x9502F90000000000ULL, 0x0000000000000000ULL },  /* 5^10 */
+   { 0xBA43B74000000000ULL, 0x0000000000000000ULL },  /* 5^11 */
+   { 0xE8D4A51000000000ULL, 0x0000000000000000ULL },  /* 5^12 */
+   { 0x9184E72A00000000ULL, 0x0000000000000000ULL },  /* 5^13 */
+   { 0xB5E620F480000000ULL, 0x0000000000000000ULL },  /* 5^14 */
+   { 0xE35FA931A0000000ULL, 0x0000000000000000ULL },  /* 5^15 */
+   { 0x8E1BC9BF04000000ULL, 0x0000000000000000ULL },  /* 5^16 */
+   { 0xB1A2BC2EC5000000ULL, 0x0000000000000000ULL },  /* 5^17 */
+   { 0xDE0B6B3A76400000ULL, 0x0000000000000000ULL },  /* 5^18 */
+   { 0x8AC7230489E80000ULL, 0x0000000000000000ULL },  /* 5^19 */
+   { 0xAD78EBC5AC620000ULL, 0x0000000000000000ULL },  /* 5^20 */
+   { 0xD8D726B7177A8000ULL, 0x0000000000000000ULL },  /* 5^21 */
+   { 0x878678326EAC9000ULL, 0x0000000000000000ULL },  /* 5^22 */
+   { 0xA968163F0A57B400ULL, 0x0000000000000000ULL },  /* 5^23 */
+   { 0xD3C21BCECCEDA100ULL, 0x0000000000000000ULL },  /* 5^24 */
+   { 0x84595161401484A0ULL, 0x0000000000000000ULL },  /* 5^25 */
+   { 0xA56FA5B99019A5C8ULL, 0x0000000000000000ULL },  /* 5^26 */
+   { 0xCECB8F27F4200F3AULL, 0x0000000000000000ULL },  /* 5^27 */
+   { 0x813F3978F8940984ULL, 0x4000000000000000ULL },  /* 5^28 */
+   { 0xA18F07D736B90BE5ULL, 0x5000000000000000ULL },  /* 5^29 */
+   { 0xC9F2C9CD04674EDEULL, 0xA400000000000000ULL },  /* 5^30 */
+   { 0xFC6F7C4045812296ULL, 0x4D00000000000000ULL },  /* 5^31 */
+   { 0x9DC5ADA82B70B59DULL, 0xF020000000000000ULL },  /* 5^32 */
+   { 0xC5371912364CE305ULL, 0x6C28000000000000ULL },  /* 5^33 */
+   { 0xF684DF56C3E01BC6ULL, 0xC732000000000000ULL },  /* 5^34 */
+   { 0x9A130B963A6C115CULL, 0x3C7F400000000000ULL },  /* 5^35 */
+   { 0xC097CE7BC90715B3ULL, 0x4B9F100000000000ULL },  /* 5^36 */
+   { 0xF0BDC21ABB48DB20ULL, 0x1E86D40000000000ULL },  /* 5^37 */
+   { 0x96769950B50D88F4ULL, 0x1314448000000000ULL },  /* 5^38 */
+   { 0xBC143FA4E250EB31ULL, 0x17D955A000000000ULL },  /* 5^39 */
+   { 0xEB194F8E1AE525FDULL, 0x5DCFAB0800000000ULL },  /* 5^40 */
+   { 0x92EFD1B8D0CF37BEULL, 0x5AA1CAE500000000ULL },  /* 5^41 */
+   { 0xB7ABC627050305ADULL, 0xF14A3D9E40000000ULL },  /* 5^42 */
+   { 0xE596B7B0C643C719ULL, 0x6D9CCD05D0000000ULL },  /* 5^43 */
+   { 0x8F7E32CE7BEA5C6FULL, 0xE4820023A2000000ULL },  /* 5^44 */
+   { 0xB35DBF821AE4F38BULL, 0xDDA2802C8A800000ULL },  /* 5^45 */
+   { 0xE0352F62A19E306EULL, 0xD50B2037AD200000ULL },  /* 5^46 */
+   { 0x8C213D9DA502DE45ULL, 0x4526F422CC340000ULL },  /* 5^47 */
+   { 0xAF298D050E4395D6ULL, 0x9670B12B7F410000ULL },  /* 5^48 */
+   { 0xDAF3F04651D47B4CULL, 0x3C0CDD765F114000ULL },  /* 5^49 */
+   { 0x88D8762BF324CD0FULL, 0xA5880A69FB6AC800ULL },  /* 5^50 */
+   { 0xAB0E93B6EFEE0053ULL, 0x8EEA0D047A457A00ULL },  /* 5^51 */
+   { 0xD5D238A4ABE98068ULL, 0x72A4904598D6D880ULL },  /* 5^52 */
+   { 0x85A36366EB71F041ULL, 0x47A6DA2B7F864750ULL },  /* 5^53 */
+   { 0xA70C3C40A64E6C51ULL, 0x999090B65F67D924ULL },  /* 5^54 */
+   { 0xD0CF4B50CFE20765ULL, 0xFFF4B4E3F741CF6DULL },  /* 5^55 */
+   { 0x82818F1281ED449FULL, 0xBFF8F10E7A8921A4ULL },  /* 5^56 */
+   { 0xA321F2D7226895C7ULL, 0xAFF72D52192B6A0DULL },  /* 5^57 */
+   { 0xCBEA6F8CEB02BB39ULL, 0x9BF4F8A69F764490ULL },  /* 5^58 */
+   { 0xFEE50B7025C36A08ULL, 0x02F236D04753D5B4ULL },  /* 5^59 */
+   { 0x9F4F2726179A2245ULL, 0x01D762422C946590ULL },  /* 5^60 */
+   { 0xC722F0EF9D80AAD6ULL, 0x424D3AD2B7B97EF5ULL },  /* 5^61 */
+   { 0xF8EBAD2B84E0D58BULL, 0xD2E0898765A7DEB2ULL },  /* 5^62 */
+   { 0x9B934C3B330C8577ULL, 0x63CC55F49F88EB2FULL },  /* 5^63 */
+   { 0xC2781F49FFCFA6D5ULL, 0x3CBF6B71C76B25FBULL }  /* 5^64 */
+};
+
+static const double exact_pow10 [] =
+{
+   1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static void multiply_64 (uint64_t a, uint64_t b, uint64_t * high, uint64_t * low)
+{
+   #ifdef __SIZEOF_INT128__
+      unsigned __int128 product = (unsigned __int128) a * b;
+
+      *high = (uint64_t) (product >> 64);
+      *low = (uint64_t) product;
+   #else
+      uint64_t a_lo = (uint32_t) a, a_hi = a >> 32;
+      uint64_t b_lo = (uint32_t) b, b_hi = b >> 32;
+      uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo;
+      uint64_t lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+      uint64_t cross = (lo_lo >> 32) + (uint32_t) hi_lo + lo_hi;
+
+      *high = hi_hi + (hi_lo >> 32) + (cross >> 32);
+      *low = (cross << 32) | (uint32_t) lo_lo;
+   #endif
+}
+
+static int leading_zeros (uint64_t val)
+{
+   #if defined(__GNUC__)
+      return __builtin_clzll (val);
+   #else
+      int zeros = 0;
+
+      for (; ! (val & 0x8000000000000000ULL); val <<= 1)
+         ++ zeros;
+
+      return zeros;
+   #endif
+}
+
+/* Eisel-Lemire: mantissa * 10^exponent rounded to nearest even.  Returns 0
+ * when it can't decide (or the result is subnormal or infinite).
+ */
+static int eisel_lemire (uint64_t mantissa, int exponent, double * dbl)
+{
+   const uint64_t * pow5;
+   uint64_t high, low, second_high, second_low, bits;
+   int lz, upperbit, shift, power2;
+
+   if (exponent < pow5_min || exponent > pow5_max)
+      return 0;
+
+   pow5 = pow5_128 [exponent - pow5_min];
+
+   lz = leading_zeros (mantissa);
+   mantissa <<= lz;
+
+   multiply_64 (mantissa, pow5 [0], &high, &low);
+
+   if ((high & 0x1FF) == 0x1FF)
+   {
+      multiply_64 (mantissa, pow5 [1], &second_high, &second_low);
+
+      low += second_high;
+
+      if (second_high > low)
+         ++ high;
+
+      if (low == 0xFFFFFFFFFFFFFFFFULL && (exponent < -27 || exponent > 55))
+         return 0;
+   }
+
+   upperbit = (int) (high >> 63);
+   shift = upperbit + 9;
+   bits = high >> shift;
+
+   power2 = (((152170 + 65536) * exponent) >> 16) + 63 + upperbit - lz + 1023;
+
+   if (power2 <= 0)
+      return 0;
+
+   /* exactly halfway: round down to even instead of up */
+   if (low <= 1 && exponent >= -4 && exponent <= 23 && (bits & 3) == 1
+         && (bits << shift) == high)
+   {
+      bits &= ~ (uint64_t) 1;
+   }
+
+   bits += (bits & 1);
+   bits >>= 1;
+
+   if (bits >= ((uint64_t) 2 << 52))
+   {
+      bits = (uint64_t) 1 << 52;
+      ++ power2;
+   }
+
+   if (power2 >= 0x7FF)
+      return 0;
+
+   bits = (bits & ~ ((uint64_t) 1 << 52)) | ((uint64_t) power2 << 52);
+   memcpy (dbl, &bits, sizeof (bits));
+
+   return 1;
+}
+
+static int decimal_to_double (uint64_t mantissa, int exponent, double * dbl)
+{
+   if (mantissa == 0)
+   {
+      *dbl = 0;
+      return 1;
+   }
+
+   if (mantissa <= ((uint64_t) 1 << 53) && exponent >= -22 && exponent <= 22)
+   {
+      *dbl = (double) mantissa;
+
+      if (exponent < 0)
+         *dbl /= exact_pow10 [- exponent];
+      else
+         *dbl *= exact_pow10 [exponent];
+
+      return 1;
+   }
+
+   return eisel_lemire (mantissa, exponent, dbl);
+}
+
+static double slow_number (const json_char * ptr, const json_char * end)
+{
+   char buf [64], * str = buf;
+   double dbl;
+
+   if ((size_t) (end - ptr) >= sizeof (buf) && ! (str = (char *) malloc (end - ptr + 1)))
+      return 0;
+
+   memcpy (str, ptr, end - ptr);
+   str [end - ptr] = 0;
+
+   dbl = strtod (str, 0);
+
+   if (str != buf)
+      free (str);
+
+   return dbl;
+}
+
+/* Validates and converts the number in [ptr, end).  Returns json_integer or
+ * json_double, or json_none with the reason in error.
+ */
+static json_type parse_number (const json_char * ptr, const json_char * end,
+                               json_int_t * integer, double * dbl,
+                               char * error)
+{
+   const json_char * number = ptr, * start;
+   json_type type = json_integer;
+   int negative = 0, truncated = 0, exponent = 0, num_digits;
+   uint64_t mantissa = 0;
+   long num_e = 0;
+
+   if (ptr < end && *ptr == '-')
+   {
+      negative = 1;
+      ++ ptr;
+   }
+
+   if (ptr == end || !isdigit ((unsigned char) *ptr))
+   {  strcpy (error, "Expected digit");
+      return json_none;
+   }
+
+   if (*ptr == '0' && (ptr + 1) < end && isdigit ((unsigned char) ptr [1]))
+   {  sprintf (error, "Unexpected `0` before `%c`", ptr [1]);
+      return json_none;
+   }
+
+   start = ptr;
+   num_digits = accumulate_digits (&ptr, end, &mantissa, &truncated);
+   exponent = (int) (ptr - start) - num_digits;  /* integer digits that didn't fit */
+
+   if (ptr < end && *ptr == '.')
+   {
+      type = json_double;
+      start = ++ ptr;
+
+      exponent -= accumulate_digits (&ptr, end, &mantissa, &truncated);
+
+      if (ptr == start)
+      {  strcpy (error, "Expected digit after `.`");
+         return json_none;
+      }
+   }
+
+   if (ptr < end && (*ptr == 'e' || *ptr == 'E'))
+   {
+      int e_negative = 0;
+
+      type = json_double;
+
+      if (++ ptr < end && (*ptr == '+' || *ptr == '-'))
+         e_negative = (*ptr ++ == '-');
+
+      for (start = ptr; ptr < end && isdigit ((unsigned char) *ptr); ++ ptr)
+      {
+         if (num_e < 100000)
+            num_e = (num_e * 10) + (*ptr - '0');
+      }
+
+      if (ptr == start)
+      {  strcpy (error, "Expected digit after `e`");
+         return json_none;
+      }
+
+      exponent += (int) (e_negative ? - num_e : num_e);
+   }
+
+   if (ptr != end)
+   {  sprintf (error, "Unexpected `%c` in number", *ptr);
+      return json_none;
+   }
+
+   if (type == json_integer)
+   {
+      /* the most negative one has no positive counterpart */
+      if (!truncated && !exponent && mantissa <= (uint64_t) JSON_INT_MAX + negative)
+      {
+         *integer = negative ? - (json_int_t) (mantissa - 1) - 1 : (json_int_t) mantissa;
+         return json_integer;
+      }
+
+      /* doesn't fit json_int_t */
+      type = json_double;
+   }
+
+   if (truncated || !decimal_to_double (mantissa, exponent, dbl))
+   {
+      *dbl = slow_number (number, end);
+      return type;
+   }
+
+   if (negative)
+      *dbl = - *dbl;
+
+   return type;
+}
+
+#define whitespace \
+   case '\n': ++ state.cur_line;  state.cur_col = 0; /* FALLTHRU */ \
+   case ' ': /* FALLTHRU */ case '\t': /* FALLTHRU */ case '\r'
+
+#define string_add(b)  \
+   do { if (!state.first_pass) string [string_length] = b;  ++ string_length; } while (0);
+
+#define line_and_col \
+   state.cur_line, state.cur_col
+
+static json_value * parse_single_pass (json_settings * settings,
+                                       const json_char * json,
+                                       size_t length,
+                                       char * error_buf);
+
+static const long
+   flag_next             = 1 << 0,
+   flag_reproc           = 1 << 1,
+   flag_need_comma       = 1 << 2,
+   flag_seek_value       = 1 << 3,
+   flag_escaped          = 1 << 4,
+   flag_string           = 1 << 5,
+   flag_need_colon       = 1 << 6,
+   flag_done             = 1 << 7,
+   flag_line_comment     = 1 << 8,
+   flag_block_comment    = 1 << 9;
+
+json_value * json_parse_ex (json_settings * settings,
+                            const json_char * json,
+                            size_t length,
+                            char * error_buf)
+{
+   char error [json_error_max];
+   const json_char * end;
+   json_value * top, * root, * alloc = 0;
+   json_state state = { 0 };
+   json_scanner scanner;
+   long flags = 0;
+
+   if (settings->settings & json_single_pass)
+      return parse_single_pass (settings, json, length, error_buf);
+
+   /* Skip UTF-8 BOM
+    */
+   if (length >= 3 && ((unsigned char) json [0]) == 0xEF
+                   && ((unsigned char) json [1]) == 0xBB
+                   && ((unsigned char) json [2]) == 0xBF)
+   {
+      json += 3;
+      length -= 3;
+   }
+
+   error[0] = '\0';
+   end = (json + length);
+
+   scanner_init (&scanner, json);
+
+   memcpy (&state.settings, settings, sizeof (json_settings));
+
+   if (!state.settings.mem_alloc)
+      state.settings.mem_alloc = default_alloc;
+
+   if (!state.settings.mem_free)
+      state.settings.mem_free = default_free;
+
+   for (state.first_pass = 1; state.first_pass >= 0; -- state.first_pass)
+   {
+      json_uchar uchar;
+      unsigned char uc_b1, uc_b2, uc_b3, uc_b4;
+      json_char * string = 0;
+      unsigned int string_length = 0;
+
+      top = root = 0;
+      flags = flag_seek_value;
+
+      state.cur_line = 1;
+
+      for (state.ptr = json ;; ++ state.ptr)
+      {
+         json_char b = (state.ptr == end ? 0 : *state.ptr);
+
+         if (flags & flag_string)
+         {
+            if (!b)
+            {  sprintf (error, "%u:%u: Unexpected EOF in string", line_and_col);
+               goto e_failed;
+            }
+
+            if (string_length > UINT_MAX - 8)
+               goto e_overflow;
+
+            if (flags & flag_escaped)
+            {
+               flags &= ~ flag_escaped;
+
+               switch (b)
+               {
+                  case 'b':  string_add ('\b');  break;
+                  case 'f':  string_add ('\f');  break;
+                  case 'n':  string_add ('\n');  break;
+                  case 'r':  string_add ('\r');  break;
+                  case 't':  string_add ('\t');  break;
+                  case 'u':
+
+                    if (end - state.ptr <= 4 ||
+                        (uc_b1 = hex_value (*++ state.ptr)) == 0xFF ||
+                        (uc_b2 = hex_value (*++ state.ptr)) == 0xFF ||
+                        (uc_b3 = hex_value (*++ state.ptr)) == 0xFF ||
+                        (uc_b4 = hex_value (*++ state.ptr)) == 0xFF)
+                    {
+                        sprintf (error, "%u:%u: Invalid character value `%c`", line_and_col, b);
+                        goto e_failed;
+                    }
+
+                    uc_b1 = (uc_b1 << 4) | uc_b2;
+                    uc_b2 = (uc_b3 << 4) | uc_b4;
+                    uchar = (uc_b1 << 8) | uc_b2;
+
+                    if ((uchar & 0xF800) == 0xD800) {
+                        json_uchar uchar2;
+
+                        if (end - state.ptr <= 6 || (*++ state.ptr) != '\\' || (*++ state.ptr) != 'u' ||
+                            (uc_b1 = hex_value (*++ state.ptr)) == 0xFF ||
+                            (uc_b2 = hex_value (*++ state.ptr)) == 0xFF ||
+                            (uc_b3 = hex_value (*++ state.ptr)) == 0xFF ||
+                            (uc_b4 = hex_value (*++ state.ptr)) == 0xFF)
+                        {
+                            sprintf (error, "%u:%u: Invalid character value `%c`", line_and_col, b);
+                            goto e_failed;
+                        }
+
+                        uc_b1 = (uc_b1 << 4) | uc_b2;
+                        uc_b2 = (uc_b3 << 4) | uc_b4;
+                        uchar2 = (uc_b1 << 8) | uc_b2;
+
+                        uchar = 0x010000 | ((uchar & 0x3FF) << 10) | (uchar2 & 0x3FF);
+                    }
+
+                    if (sizeof (json_char) >= sizeof (json_uchar) || (uchar <= 0x7F))
+                    {
+                       string_add ((json_char) uchar);
+                       break;
+                    }
+
+                    if (uchar <= 0x7FF)
+                    {
+                        if (state.first_pass)
+                           string_length += 2;
+                        else
+                        {  string [string_length ++] = 0xC0 | (uchar >> 6);
+                           string [string_length ++] = 0x80 | (uchar & 0x3F);
+                        }
+
+                        break;
+                    }
+
+                    if (uchar <= 0xFFFF) {
+                        if (state.first_pass)
+                           string_length += 3;
+                        else
+                        {  string [string_length ++] = 0xE0 | (uchar >> 12);
+                           string [string_length ++] = 0x80 | ((uchar >> 6) & 0x3F);
+                           string [string_length ++] = 0x80 | (uchar & 0x3F);
+                        }
+
+                        break;
+                    }
+
+                    if (state.first_pass)
+                       string_length += 4;
+                    else
+                    {  string [string_length ++] = 0xF0 | (uchar >> 18);
+                       string [string_length ++] = 0x80 | ((uchar >> 12) & 0x3F);
+                       string [string_length ++] = 0x80 | ((uchar >> 6) & 0x3F);
+                       string [string_length ++] = 0x80 | (uchar & 0x3F);
+                    }
+
+                    break;
+
+                  default:
+                     string_add (b);
+               };
+
+               continue;
+            }
+
+            if (b == '\\')
+            {
+               flags |= flag_escaped;
+               continue;
+            }
+
+            if (b == '"')
+            {
+               if (!state.first_pass)
+                  string [string_length] = 0;
+
+               flags &= ~ flag_string;
+               string = 0;
+
+               switch (top->type)
+               {
+                  case json_string:
+
+                     top->u.string.length = string_length;
+                     flags |= flag_next;
+
+                     break;
+
+                  case json_object:
+
+                     if (state.first_pass) {
+                        json_char **chars = (json_char **) &top->u.object.values;
+                        chars[0] += string_length + 1;
+                     }
+                     else
+                     {
+                        top->u.object.values [top->u.object.length].name
+                           = (json_char *) top->_reserved.object_mem;
+
+                        top->u.object.values [top->u.object.length].name_length
+                           = string_length;
+
+                        (*(json_char **) &top->_reserved.object_mem) += string_length + 1;
+                     }
+
+                     flags |= flag_seek_value | flag_need_colon;
+                     continue;
+
+                  default:
+                     break;
+               };
+            }
+            else
+            {
+               string_add (b);
+               continue;
+            }
+         }
+
+         if (state.settings.settings & json_enable_comments)
+         {
+            if (flags & (flag_line_comment | flag_block_comment))
+            {
+               if (flags & flag_line_comment)
+               {
+                  if (b == '\r' || b == '\n' || !b)
+                  {
+                     flags &= ~ flag_line_comment;
+                     -- state.ptr;  /* so null can be reproc'd */
+                  }
+
+                  continue;
+               }
+
+               if (flags & flag_block_comment)
+               {
+                  if (!b)
+                  {  sprintf (error, "%u:%u: Unexpected EOF in block comment", line_and_col);
+                     goto e_failed;
+                  }
+
+                  if (b == '*' && state.ptr < (end - 1) && state.ptr [1] == '/')
+                  {
+                     flags &= ~ flag_block_comment;
+                     ++ state.ptr;  /* skip closing sequence */
+                  }
 
                   continue;
                }
             }
-            else if (b == '/')
+            else if (b == '/')
+            {
+               if (! (flags & (flag_seek_value | flag_done)) && top->type != json_object)
+               {  sprintf (error, "%u:%u: Comment not allowed here", line_and_col);
+                  goto e_failed;
+               }
+
+               if (++ state.ptr == end)
+               {  sprintf (error, "%u:%u: EOF unexpected", line_and_col);
+                  goto e_failed;
+               }
+
+               switch (b = *state.ptr)
+               {
+                  case '/':
+                     flags |= flag_line_comment;
+                     continue;
+
+                  case '*':
+                     flags |= flag_block_comment;
+                     continue;
+
+                  default:
+                     sprintf (error, "%u:%u: Unexpected `%c` in comment opening sequence", line_and_col, b);
+                     goto e_failed;
+               };
+            }
+         }
+
+         if (flags & flag_done)
+         {
+            if (!b)
+               break;
+
+            switch (b)
+            {
+               whitespace:
+                  continue;
+
+               default:
+
+                  sprintf (error, "%u:%u: Trailing garbage: `%c`",
+                           line_and_col, b);
+
+                  goto e_failed;
+            };
+         }
+
+         if (flags & flag_seek_value)
+         {
+            switch (b)
+            {
+               whitespace:
+                  continue;
+
+               case ']':
+
+                  if (top && top->type == json_array)
+                     flags = (flags & ~ (flag_need_comma | flag_seek_value)) | flag_next;
+                  else
+                  {  sprintf (error, "%u:%u: Unexpected `]`", line_and_col);
+                     goto e_failed;
+                  }
+
+                  break;
+
+               default:
+
+                  if (flags & flag_need_comma)
+                  {
+                     if (b == ',')
+                     {  flags &= ~ flag_need_comma;
+                        continue;
+                     }
+                     else
+                     {
+                        sprintf (error, "%u:%u: Expected `,` before `%c`",
+                                 line_and_col, b);
+
+                        goto e_failed;
+                     }
+                  }
+
+                  if (flags & flag_need_colon)
+                  {
+                     if (b == ':')
+                     {  flags &= ~ flag_need_colon;
+                        continue;
+                     }
+                     else
+                     {
+                        sprintf (error, "%u:%u: Expected `:` before `%c`",
+                                 line_and_col, b);
+
+                        goto e_failed;
+                     }
+                  }
+
+                  flags &= ~ flag_seek_value;
+
+                  switch (b)
+                  {
+                     case '{':
+
+                        if (!new_value (&state, &top, &root, &alloc, json_object))
+                           goto e_alloc_failure;
+
+                        continue;
+
+                     case '[':
+
+                        if (!new_value (&state, &top, &root, &alloc, json_array))
+                           goto e_alloc_failure;
+
+                        flags |= flag_seek_value;
+                        continue;
+
+                     case '"':
+
+                        if (!new_value (&state, &top, &root, &alloc, json_string))
+                           goto e_alloc_failure;
+
+                        flags |= flag_string;
+
+                        string = top->u.string.ptr;
+                        string_length = 0;
+
+                        continue;
+
+                     case 't':
+
+                        if ((end - state.ptr) <= 3 || *(++ state.ptr) != 'r' ||
+                            *(++ state.ptr) != 'u' || *(++ state.ptr) != 'e')
+                        {
+                           goto e_unknown_value;
+                        }
+
+                        if (!new_value (&state, &top, &root, &alloc, json_boolean))
+                           goto e_alloc_failure;
+
+                        top->u.boolean = 1;
+
+                        flags |= flag_next;
+                        break;
+
+                     case 'f':
+
+                        if ((end - state.ptr) <= 4 || *(++ state.ptr) != 'a' ||
+                            *(++ state.ptr) != 'l' || *(++ state.ptr) != 's' ||
+                            *(++ state.ptr) != 'e')
+                        {
+                           goto e_unknown_value;
+                        }
+
+                        if (!new_value (&state, &top, &root, &alloc, json_boolean))
+                           goto e_alloc_failure;
+
+                        flags |= flag_next;
+                        break;
+
+                     case 'n':
+
+                        if ((end - state.ptr) <= 3 || *(++ state.ptr) != 'u' ||
+                            *(++ state.ptr) != 'l' || *(++ state.ptr) != 'l')
+                        {
+                           goto e_unknown_value;
+                        }
+
+                        if (!new_value (&state, &top, &root, &alloc, json_null))
+                           goto e_alloc_failure;
+
+                        flags |= flag_next;
+                        break;
+
+                     default:
+
+                        if (isdigit ((unsigned char) b) || b == '-')
+                        {
+                           const json_char * number = state.ptr;
+
+                           if (!new_value (&state, &top, &root, &alloc, json_integer))
+                              goto e_alloc_failure;
+
+                           state.ptr = scan_number_end (&scanner, state.ptr, end);
+
+                           /* the second pass reuses the value decoded in the first */
+                           if (state.first_pass)
+                           {
+                              char reason [64];
+                              json_type type = parse_number (number, state.ptr,
+                                                   &top->u.integer, &top->u.dbl, reason);
+
+                              if (type == json_none)
+                              {  sprintf (error, "%u:%u: %s", line_and_col, reason);
+                                 goto e_failed;
+                              }
+
+                              top->type = type;
+                           }
+
+                           flags |= flag_next | flag_reproc;
+                           break;
+                        }
+                        else
+                        {  sprintf (error, "%u:%u: Unexpected `%c` when seeking value", line_and_col, b);
+                           goto e_failed;
+                        }
+                  };
+            };
+         }
+         else
+         {
+            switch (top->type)
+            {
+            case json_object:
+
+               switch (b)
+               {
+                  whitespace:
+                     continue;
+
+                  case '"':
+
+                     if (flags & flag_need_comma)
+                     {  sprintf (error, "%u:%u: Expected `,` before `\"`", line_and_col);
+                        goto e_failed;
+                     }
+
+                     flags |= flag_string;
+
+                     string = (json_char *) top->_reserved.object_mem;
+                     string_length = 0;
+
+                     break;
+
+                  case '}':
+
+                     flags = (flags & ~ flag_need_comma) | flag_next;
+                     break;
+
+                  case ',':
+
+                     if (flags & flag_need_comma)
+                     {
+                        flags &= ~ flag_need_comma;
+                        break;
+                     } /* FALLTHRU */
+
+                  default:
+                     sprintf (error, "%u:%u: Unexpected `%c` in object", line_and_col, b);
+                     goto e_failed;
+               };
+
+               break;
+
+            default:
+               break;
+            };
+         }
+
+         if (flags & flag_reproc)
+         {
+            flags &= ~ flag_reproc;
+            -- state.ptr;
+         }
+
+         if (flags & flag_next)
+         {
+            flags = (flags & ~ flag_next) | flag_need_comma;
+
+            if (!top->parent)
+            {
+               /* root value done */
+
+               flags |= flag_done;
+               continue;
+            }
+
+            if (top->parent->type == json_array)
+               flags |= flag_seek_value;
+
+            if (!state.first_pass)
+            {
+               json_value * parent = top->parent;
+
+               switch (parent->type)
+               {
+                  case json_object:
+
+                     parent->u.object.values
+                        [parent->u.object.length].value = top;
+
+                     break;
+
+                  case json_array:
+
+                     parent->u.array.values
+                           [parent->u.array.length] = top;
+
+                     break;
+
+                  default:
+                     break;
+               };
+            }
+
+            if ( (++ top->parent->u.array.length) > UINT_MAX - 8)
+               goto e_overflow;
+
+            top = top->parent;
+
+            continue;
+         }
+      }
+
+      alloc = root;
+   }
+
+   return root;
+
+e_unknown_value:
+
+   sprintf (error, "%u:%u: Unknown value", line_and_col);
+   goto e_failed;
+
+e_alloc_failure:
+
+   strcpy (error, "Memory allocation failure");
+   goto e_failed;
+
+e_overflow:
+
+   sprintf (error, "%u:%u: Too long (caught overflow)", line_and_col);
+   goto e_failed;
+
+e_failed:
+
+   if (error_buf)
+   {
+      if (*error)
+         strcpy (error_buf, error);
+      else
+         strcpy (error_buf, "Unknown error");
+   }
+
+   if (state.first_pass)
+      alloc = root;
+
+   while (alloc)
+   {
+      top = alloc->_reserved.next_alloc;
+      state.settings.mem_free (alloc, state.settings.user_data);
+      alloc = top;
+   }
+
+   if (!state.first_pass)
+      json_value_free_ex (&state.settings, root);
+
+   return 0;
+}
+
+json_value * json_parse (const json_char * json, size_t length)
+{
+   json_settings settings = { 0 };
+   return json_parse_ex (&settings, json, length, 0);
+}
+
+void json_value_free_ex (json_settings * settings, json_value * value)
+{
+   json_value * cur_value;
+
+   if (!value)
+      return;
+
+   value->parent = 0;
+
+   while (value)
+   {
+      switch (value->type)
+      {
+         case json_array:
+
+            if (!value->u.array.length)
+            {
+               settings->mem_free (value->u.array.values, settings->user_data);
+               break;
+            }
+
+            value = value->u.array.values [-- value->u.array.length];
+            continue;
+
+         case json_object:
+
+            if (!value->u.object.length)
+            {
+               settings->mem_free (value->u.object.values, settings->user_data);
+               break;
+            }
+
+            value = value->u.object.values [-- value->u.object.length].value;
+            continue;
+
+         case json_string:
+
+            settings->mem_free (value->u.string.ptr, settings->user_data);
+            break;
+
+         default:
+            break;
+      };
+
+      cur_value = value;
+      value = value->parent;
+      settings->mem_free (cur_value, settings->user_data);
+   }
+}
+
+void json_value_free (json_value * value)
+{
+   json_settings settings = { 0 };
+   settings.mem_free = default_free;
+   json_value_free_ex (&settings, value);
+}
+
+/* Arena allocator
+ */
+
+struct _json_arena_block
+{
+   json_arena_block * next;
+   size_t size, used;
+};
+
+/* keeps every allocation aligned for doubles and pointers */
+#define arena_align(size) \
+   (((size) + (2 * sizeof (double) - 1)) & ~ (2 * sizeof (double) - 1))
+
+/* A [timestamp, value] pair is ~35 chars of input and turns into three
+ * json_values plus a vector, so numeric documents need about 4x their size.
+ */
+#define arena_bytes_per_char 4
+
+static json_arena_block * arena_new_block (size_t size)
+{
+   json_arena_block * block;
+
+   if (! (block = (json_arena_block *) malloc
+            (arena_align (sizeof (json_arena_block)) + size)))
+   {
+      return 0;
+   }
+
+   block->next = 0;
+   block->size = size;
+   block->used = 0;
+
+   return block;
+}
+
+static void * arena_alloc (size_t size, int zero, void * user_data)
+{
+   json_arena * arena = (json_arena *) user_data;
+   json_arena_block * block = arena->blocks;
+   void * mem;
+
+   size = arena_align (size);
+
+   if (!block || (block->size - block->used) < size)
+   {
+      if (! (block = arena_new_block (size > arena->block_size ? size : arena->block_size)))
+         return 0;
+
+      if (size > arena->block_size && arena->blocks)
+      {
+         /* oversized: keep filling the current block afterwards */
+         block->next = arena->blocks->next;
+         arena->blocks->next = block;
+      }
+      else
+      {
+         block->next = arena->blocks;
+         arena->blocks = block;
+      }
+   }
+
+   mem = ((char *) block) + arena_align (sizeof (json_arena_block)) + block->used;
+   block->used += size;
+
+   if (zero)
+      memset (mem, 0, size);
+
+   return mem;
+}
+
+static void arena_free (void * ptr, void * user_data)
+{
+   /* everything goes at once in json_arena_reset */
+   (void)ptr;
+   (void)user_data;
+}
+
+int json_arena_init (json_arena * arena, size_t json_length)
+{
+   arena->block_size = arena_align (json_length * arena_bytes_per_char + 4096);
+   arena->blocks = arena_new_block (arena->block_size);
+
+   return arena->blocks != 0;
+}
+
+void json_arena_settings (json_arena * arena, json_settings * settings)
+{
+   settings->mem_alloc = arena_alloc;
+   settings->mem_free = arena_free;
+   settings->user_data = arena;
+}
+
+void json_arena_reset (json_arena * arena)
+{
+   json_arena_block * block = arena->blocks, * next;
+   size_t total = 0;
+
+   if (!block)
+      return;
+
+   if (!block->next)
+   {
+      block->used = 0;
+      return;
+   }
+
+   for (; block; block = next)
+   {
+      next = block->next;
+      total += block->size;
+      free (block);
+   }
+
+   /* if this fails the next allocation tries again */
+   arena->block_size = total;
+   arena->blocks = arena_new_block (total);
+}
+
+void json_arena_free (json_arena * arena)
+{
+   json_arena_block * block, * next;
+
+   for (block = arena->blocks; block; block = next)
+   {
+      next = block->next;
+      free (block);
+   }
+
+   arena->blocks = 0;
+}
+
+/* Event (SAX) decoder
+ *
+ * Works in a single pass over the input: the only state kept between
+ * tokens is the container stack and what the next token has to be.
+ */
+
+typedef enum
+{
+   sax_seek_value,
+   sax_seek_value_or_close,  /* just after `[` or a `,` in an array */
+   sax_seek_key,
+   sax_seek_key_or_close,    /* just after `{` or a `,` in an object */
+   sax_need_colon,
+   sax_need_comma,
+   sax_done
+
+} json_sax_expect;
+
+typedef struct
+{
+   json_state state;  /* settings, memory accounting and cur_line */
+   json_sax_handler handler;
+
+   json_type * stack;
+   size_t depth, stack_size;
+
+   json_sax_expect expect;
+
+   json_scanner scanner;
+
+   json_char * scratch;  /* decoded strings and keys */
+   size_t scratch_size;
+
+   const json_char * line_start;
+
+   char error [json_error_max];
+
+} json_sax_state;
+
+#define sax_line_and_col(ptr) \
+   sax->state.cur_line, (unsigned int) ((ptr) - sax->line_start)
+
+/* Grows *mem (of *size elements) to hold at least `needed`, doubling */
+static int json_reserve (json_state * state, void ** mem, size_t * size,
+                         size_t needed, size_t elem_size)
+{
+   void * grown;
+   size_t new_size = *size ? *size : 32;
+
+   if (needed <= *size)
+      return 1;
+
+   while (new_size < needed)
+      new_size *= 2;
+
+   if (! (grown = json_alloc (state, new_size * elem_size, 0)))
+      return 0;
+
+   if (*mem)
+   {
+      memcpy (grown, *mem, *size * elem_size);
+      state->settings.mem_free (*mem, state->settings.user_data);
+   }
+
+   *mem = grown;
+   *size = new_size;
+
+   return 1;
+}
+
+static const json_char * sax_skip_whitespace (json_sax_state * sax,
+                                              const json_char * ptr,
+                                              const json_char * end)
+{
+   if (ptr == end)
+      return ptr;
+
+   switch (*ptr)
+   {
+      case ' ': case '\t': case '\r': case '\n':
+         return scan_whitespace_end (&sax->scanner, ptr, end,
+                                     &sax->state.cur_line, &sax->line_start);
+
+      default:
+         return ptr;
+   };
+}
+
+/* Skips a comment starting at ptr.  Returns 1 if skipped, 0 if the comment
+ * doesn't end before `end` or -1 on error.
+ */
+static int sax_comment (json_sax_state * sax, const json_char ** pptr,
+                        const json_char * end, int final)
+{
+   const json_char * ptr = *pptr;
+
+   if (end - ptr < 2)
+   {
+      if (final)
+      {  sprintf (sax->error, "%u:%u: EOF unexpected", sax_line_and_col (ptr));
+         return -1;
+      }
+
+      return 0;
+   }
+
+   switch (ptr [1])
+   {
+      case '/':
+
+         for (ptr += 2; ptr < end && *ptr != '\r' && *ptr != '\n'; ++ ptr)
+            ;
+
+         if (ptr == end && !final)
+            return 0;
+
+         break;
+
+      case '*':
+
+         for (ptr += 2; ptr < end - 1 && ! (ptr [0] == '*' && ptr [1] == '/'); ++ ptr)
+         {
+            if (*ptr == '\n')
+            {  ++ sax->state.cur_line;
+               sax->line_start = ptr + 1;
+            }
+         }
+
+         if (ptr >= end - 1)
+         {
+            if (!final)
+               return 0;
+
+            sprintf (sax->error, "%u:%u: Unexpected EOF in block comment", sax_line_and_col (ptr));
+            return -1;
+         }
+
+         ptr += 2;
+         break;
+
+      default:
+
+         sprintf (sax->error, "%u:%u: Unexpected `%c` in comment opening sequence",
+                  sax_line_and_col (ptr), ptr [1]);
+         return -1;
+   };
+
+   *pptr = ptr;
+   return 1;
+}
+
+/* Decodes the string whose opening quote is at *pptr into the scratch
+ * buffer.  Returns 1 if decoded, 0 if the closing quote isn't before `end`
+ * or -1 on error.
+ */
+static int sax_string (json_sax_state * sax, const json_char ** pptr,
+                       const json_char * end, int final,
+                       unsigned int * length)
+{
+   const json_char * ptr = *pptr + 1, * close;
+   json_char * string;
+   unsigned int string_length = 0;
+   unsigned char uc_b1, uc_b2, uc_b3, uc_b4;
+   json_uchar uchar, uchar2;
+
+   for (close = scan_string_special (&sax->scanner, ptr, end);
+        close < end && *close != '"';
+        close = scan_string_special (&sax->scanner, close + 2, end))
+   {
+      /* skipping the escaped character */
+      if (close + 2 > end)
+      {
+         close = end;
+         break;
+      }
+   }
+
+   if (close >= end)
+   {
+      if (!final)
+         return 0;
+
+      sprintf (sax->error, "%u:%u: Unexpected EOF in string", sax_line_and_col (end));
+      return -1;
+   }
+
+   if ((size_t) (close - ptr) > UINT_MAX - 8)
+   {  sprintf (sax->error, "%u:%u: Too long (caught overflow)", sax_line_and_col (ptr));
+      return -1;
+   }
+
+   if (!json_reserve (&sax->state, (void **) &sax->scratch, &sax->scratch_size,
+                      (close - ptr) + 1, sizeof (json_char)))
+   {
+      strcpy (sax->error, "Memory allocation failure");
+      return -1;
+   }
+
+   string = sax->scratch;
+
+   for (; ptr < close; ++ ptr)
+   {
+      if (*ptr != '\\')
+      {
+         string [string_length ++] = *ptr;
+         continue;
+      }
+
+      switch (*++ ptr)
+      {
+         case 'b':  string [string_length ++] = '\b';  break;
+         case 'f':  string [string_length ++] = '\f';  break;
+         case 'n':  string [string_length ++] = '\n';  break;
+         case 'r':  string [string_length ++] = '\r';  break;
+         case 't':  string [string_length ++] = '\t';  break;
+         case 'u':
+
+            if (close - ptr <= 4 ||
+                (uc_b1 = hex_value (*++ ptr)) == 0xFF ||
+                (uc_b2 = hex_value (*++ ptr)) == 0xFF ||
+                (uc_b3 = hex_value (*++ ptr)) == 0xFF ||
+                (uc_b4 = hex_value (*++ ptr)) == 0xFF)
             {
-               if (! (flags & (flag_seek_value | flag_done)) && top->type != json_object)
-               {  sprintf (error, "%u:%u: Comment not allowed here", line_and_col);
-                  goto e_failed;
-               }
+               sprintf (sax->error, "%u:%u: Invalid character value `%c`", sax_line_and_col (ptr), *ptr);
+               return -1;
+            }
 
-               if (++ state.ptr == end)
-               {  sprintf (error, "%u:%u: EOF unexpected", line_and_col);
-                  goto e_failed;
+            uc_b1 = (uc_b1 << 4) | uc_b2;
+            uc_b2 = (uc_b3 << 4) | uc_b4;
+            uchar = (uc_b1 << 8) | uc_b2;
+
+            if ((uchar & 0xF800) == 0xD800)
+            {
+               if (close - ptr <= 6 || (*++ ptr) != '\\' || (*++ ptr) != 'u' ||
+                   (uc_b1 = hex_value (*++ ptr)) == 0xFF ||
+                   (uc_b2 = hex_value (*++ ptr)) == 0xFF ||
+                   (uc_b3 = hex_value (*++ ptr)) == 0xFF ||
+                   (uc_b4 = hex_value (*++ ptr)) == 0xFF)
+               {
+                  sprintf (sax->error, "%u:%u: Invalid character value `%c`", sax_line_and_col (ptr), *ptr);
+                  return -1;
                }
 
-               switch (b = *state.ptr)
-               {
-                  case '/':
-                     flags |= flag_line_comment;
-                     continue;
+               uc_b1 = (uc_b1 << 4) | uc_b2;
+               uc_b2 = (uc_b3 << 4) | uc_b4;
+               uchar2 = (uc_b1 << 8) | uc_b2;
+
+               uchar = 0x010000 | ((uchar & 0x3FF) << 10) | (uchar2 & 0x3FF);
+            }
+
+            if (sizeof (json_char) >= sizeof (json_uchar) || (uchar <= 0x7F))
+            {
+               string [string_length ++] = (json_char) uchar;
+            }
+            else if (uchar <= 0x7FF)
+            {
+               string [string_length ++] = 0xC0 | (uchar >> 6);
+               string [string_length ++] = 0x80 | (uchar & 0x3F);
+            }
+            else if (uchar <= 0xFFFF)
+            {
+               string [string_length ++] = 0xE0 | (uchar >> 12);
+               string [string_length ++] = 0x80 | ((uchar >> 6) & 0x3F);
+               string [string_length ++] = 0x80 | (uchar & 0x3F);
+            }
+            else
+            {
+               string [string_length ++] = 0xF0 | (uchar >> 18);
+               string [string_length ++] = 0x80 | ((uchar >> 12) & 0x3F);
+               string [string_length ++] = 0x80 | ((uchar >> 6) & 0x3F);
+               string [string_length ++] = 0x80 | (uchar & 0x3F);
+            }
+
+            break;
+
+         default:
+            string [string_length ++] = *ptr;
+      };
+   }
+
+   string [string_length] = 0;
+
+   *length = string_length;
+   *pptr = close + 1;
+
+   return 1;
+}
+
+
+static int sax_literal (json_sax_state * sax, const json_char ** pptr,
+                        const json_char * end, int final,
+                        const char * literal, size_t literal_length)
+{
+   const json_char * ptr = *pptr;
+
+   if ((size_t) (end - ptr) < literal_length)
+   {
+      if (!final && !memcmp (ptr, literal, end - ptr))
+         return 0;
+   }
+   else if (!memcmp (ptr, literal, literal_length))
+   {
+      *pptr = ptr + literal_length;
+      return 1;
+   }
+
+   sprintf (sax->error, "%u:%u: Unknown value", sax_line_and_col (ptr));
+   return -1;
+}
+
+/* Decodes one number of a series element.  Returns 0 if there isn't a
+ * complete, valid number at ptr.
+ */
+static int sax_series_number (json_sax_state * sax, const json_char ** pptr,
+                              const json_char * end, json_int_t * integer, double * dbl,
+                              json_type * type)
+{
+   const json_char * ptr = *pptr, * number_end;
+   char error [64];
+
+   if (ptr == end || (!isdigit ((unsigned char) *ptr) && *ptr != '-'))
+      return 0;
+
+   /* a number running into `end` might continue in the next buffer */
+   if ((number_end = scan_number_end (&sax->scanner, ptr, end)) == end)
+      return 0;
+
+   if ((*type = parse_number (ptr, number_end, integer, dbl, error)) == json_none)
+      return 0;
+
+   *pptr = number_end;
+   return 1;
+}
+
+#define json_series_batch 256
+
+/* Fast path for the elements of an array that are [integer, number] pairs,
+ * starting at the `[` of such an element.  Decodes as many consecutive
+ * pairs as it can and hands them to handler->series in batches, stopping
+ * before the first element (or separating `,`) of any other shape, which is
+ * then left to sax_run, errors included.  Returns 0 if the handler aborted.
+ */
+static int sax_series (json_sax_state * sax, const json_char ** pptr,
+                       const json_char * end)
+{
+   json_sax_handler * handler = &sax->handler;
+   json_int_t first [json_series_batch];
+   double second [json_series_batch];
+   size_t count = 0, decoded = 0;
+   const json_char * ptr = *pptr, * line_start;
+   unsigned int cur_line;
+   json_int_t integer;
+   double dbl;
+   json_type type;
+
+   for (;;)
+   {
+      /* whitespace may hold newlines, so the line count is restored along
+       * with ptr if the element turns out not to match
+       */
+      cur_line = sax->state.cur_line;
+      line_start = sax->line_start;
+
+      if (decoded)
+      {
+         if ((ptr = sax_skip_whitespace (sax, ptr, end)) == end || *ptr != ',')
+            break;
+
+         ptr = sax_skip_whitespace (sax, ptr + 1, end);
+      }
+
+      if (ptr == end || *ptr != '[')
+         break;
+
+      ptr = sax_skip_whitespace (sax, ptr + 1, end);
+
+      if (!sax_series_number (sax, &ptr, end, &integer, &dbl, &type) || type != json_integer)
+         break;
+
+      first [count] = integer;
+
+      if ((ptr = sax_skip_whitespace (sax, ptr, end)) == end || *ptr != ',')
+         break;
+
+      ptr = sax_skip_whitespace (sax, ptr + 1, end);
+
+      if (!sax_series_number (sax, &ptr, end, &integer, &dbl, &type))
+         break;
+
+      second [count] = type == json_integer ? (double) integer : dbl;
+
+      if ((ptr = sax_skip_whitespace (sax, ptr, end)) == end || *ptr != ']')
+         break;
+
+      *pptr = ++ ptr;
+      ++ decoded;
+
+      if (++ count == json_series_batch)
+      {
+         if (!handler->series (first, second, count, handler->user_data))
+            return 0;
+
+         count = 0;
+      }
+   }
+
+   sax->state.cur_line = cur_line;
+   sax->line_start = line_start;
+
+   if (count && !handler->series (first, second, count, handler->user_data))
+      return 0;
+
+   return 1;
+}
+
+/* Returns where decoding stopped: `end`, or the start of a token that
+ * doesn't end before `end` when !final.  Returns 0 on error.
+ */
+static const json_char * sax_run (json_sax_state * sax,
+                                  const json_char * ptr,
+                                  const json_char * end,
+                                  int final)
+{
+   json_sax_handler * handler = &sax->handler;
+   void * user_data = handler->user_data;
+   const json_char * token;
+   unsigned int length;
+   json_int_t integer;
+   double dbl;
+   json_type type;
+   char error [64];  /* parse_number reason, without position */
+   int res;
+
+   for (;;)
+   {
+      if ((ptr = sax_skip_whitespace (sax, ptr, end)) == end)
+      {
+         if (final && sax->expect != sax_done)
+         {  sprintf (sax->error, "%u:%u: Unexpected EOF", sax_line_and_col (ptr));
+            return 0;
+         }
+
+         return ptr;
+      }
+
+      if (*ptr == '/' && (sax->state.settings.settings & json_enable_comments))
+      {
+         if ((res = sax_comment (sax, &ptr, end, final)) < 0)
+            return 0;
+
+         if (!res)
+            return ptr;
+
+         continue;
+      }
+
+      token = ptr;
+
+      switch (sax->expect)
+      {
+         case sax_done:
+
+            sprintf (sax->error, "%u:%u: Trailing garbage: `%c`", sax_line_and_col (ptr), *ptr);
+            return 0;
+
+         case sax_need_colon:
+
+            if (*ptr != ':')
+            {  sprintf (sax->error, "%u:%u: Expected `:` before `%c`", sax_line_and_col (ptr), *ptr);
+               return 0;
+            }
+
+            sax->expect = sax_seek_value;
+            ++ ptr;
+            continue;
+
+         case sax_need_comma:
+
+            /* one trailing comma is let through, as json_parse_ex does */
+            if (*ptr == ',')
+            {
+               sax->expect = sax->stack [sax->depth - 1] == json_object
+                                 ? sax_seek_key_or_close : sax_seek_value_or_close;
+               ++ ptr;
+               continue;
+            }
+
+            if (*ptr == '}' || *ptr == ']')
+               break;
+
+            sprintf (sax->error, "%u:%u: Expected `,` before `%c`", sax_line_and_col (ptr), *ptr);
+            return 0;
+
+         case sax_seek_key_or_close:
+
+            if (*ptr == '}')
+               break;
 
-                  case '*':
-                     flags |= flag_block_comment;
-                     continue;
+            /* FALLTHRU */
 
-                  default:
-                     sprintf (error, "%u:%u: Unexpected `%c` in comment opening sequence", line_and_col, b);
-                     goto e_failed;
-               };
+         case sax_seek_key:
+
+            if (*ptr != '"')
+            {  sprintf (sax->error, "%u:%u: Unexpected `%c` in object", sax_line_and_col (ptr), *ptr);
+               return 0;
             }
-         }
 
-         if (flags & flag_done)
-         {
-            if (!b)
+            if ((res = sax_string (sax, &ptr, end, final, &length)) < 0)
+               return 0;
+
+            if (!res)
+               return token;
+
+            if (handler->key && !handler->key (sax->scratch, length, user_data))
+               goto aborted;
+
+            sax->expect = sax_need_colon;
+            continue;
+
+         case sax_seek_value_or_close:
+
+            if (*ptr == ']')
                break;
 
-            switch (b)
+            /* FALLTHRU */
+
+         case sax_seek_value:
+
+            switch (*ptr)
             {
-               whitespace:
-                  continue;
+               case '{':
+               case '[':
 
-               default:
+                  if (*token == '[' && handler->series
+                        && sax->depth && sax->stack [sax->depth - 1] == json_array)
+                  {
+                     if (!sax_series (sax, &ptr, end))
+                        goto aborted;
 
-                  sprintf (error, "%u:%u: Trailing garbage: `%c`",
-                           line_and_col, b);
+                     if (ptr != token)
+                     {
+                        sax->expect = sax_need_comma;
+                        continue;
+                     }
+                  }
 
-                  goto e_failed;
-            };
-         }
+                  if (sax->depth == sax->stack_size
+                        && !json_reserve (&sax->state, (void **) &sax->stack, &sax->stack_size,
+                                          sax->depth + 1, sizeof (json_type)))
+                  {
+                     strcpy (sax->error, "Memory allocation failure");
+                     return 0;
+                  }
 
-         if (flags & flag_seek_value)
-         {
-            switch (b)
-            {
-               whitespace:
-                  continue;
+                  ++ ptr;
 
-               case ']':
+                  if (*token == '{')
+                  {
+                     sax->stack [sax->depth ++] = json_object;
+                     sax->expect = sax_seek_key_or_close;
 
-                  if (top && top->type == json_array)
-                     flags = (flags & ~ (flag_need_comma | flag_seek_value)) | flag_next;
+                     if (handler->object_begin && !handler->object_begin (user_data))
+                        goto aborted;
+                  }
                   else
-                  {  sprintf (error, "%u:%u: Unexpected `]`", line_and_col);
-                     goto e_failed;
+                  {
+                     sax->stack [sax->depth ++] = json_array;
+                     sax->expect = sax_seek_value_or_close;
+
+                     if (handler->array_begin && !handler->array_begin (user_data))
+                        goto aborted;
                   }
 
+                  continue;
+
+               case '"':
+
+                  if ((res = sax_string (sax, &ptr, end, final, &length)) < 0)
+                     return 0;
+
+                  if (!res)
+                     return token;
+
+                  if (handler->string && !handler->string (sax->scratch, length, user_data))
+                     goto aborted;
+
                   break;
 
-               default:
+               case 't':
+               case 'f':
 
-                  if (flags & flag_need_comma)
-                  {
-                     if (b == ',')
-                     {  flags &= ~ flag_need_comma;
-                        continue;
-                     }
-                     else
-                     {
-                        sprintf (error, "%u:%u: Expected `,` before `%c`",
-                                 line_and_col, b);
+                  if ((res = (*ptr == 't' ? sax_literal (sax, &ptr, end, final, "true", 4)
+                                          : sax_literal (sax, &ptr, end, final, "false", 5))) < 0)
+                     return 0;
 
-                        goto e_failed;
-                     }
-                  }
+                  if (!res)
+                     return token;
 
-                  if (flags & flag_need_colon)
-                  {
-                     if (b == ':')
-                     {  flags &= ~ flag_need_colon;
-                        continue;
-                     }
-                     else
-                     {
-                        sprintf (error, "%u:%u: Expected `:` before `%c`",
-                                 line_and_col, b);
+                  if (handler->boolean && !handler->boolean (*token == 't', user_data))
+                     goto aborted;
 
-                        goto e_failed;
-                     }
+                  break;
+
+               case 'n':
+
+                  if ((res = sax_literal (sax, &ptr, end, final, "null", 4)) < 0)
+                     return 0;
+
+                  if (!res)
+                     return token;
+
+                  if (handler->null && !handler->null (user_data))
+                     goto aborted;
+
+                  break;
+
+               default:
+
+                  if (!isdigit ((unsigned char) *ptr) && *ptr != '-')
+                  {  sprintf (sax->error, "%u:%u: Unexpected `%c` when seeking value", sax_line_and_col (ptr), *ptr);
+                     return 0;
                   }
 
-                  flags &= ~ flag_seek_value;
+                  ptr = scan_number_end (&sax->scanner, ptr, end);
 
-                  switch (b)
-                  {
-                     case '{':
+                  if (ptr == end && !final)
+                     return token;
 
-                        if (!new_value (&state, &top, &root, &alloc, json_object))
-                           goto e_alloc_failure;
+                  if ((type = parse_number (token, ptr, &integer, &dbl, error)) == json_none)
+                  {  sprintf (sax->error, "%u:%u: %s", sax_line_and_col (token), error);
+                     return 0;
+                  }
 
-                        continue;
+                  if (type == json_integer)
+                  {
+                     if (handler->integer && !handler->integer (integer, user_data))
+                        goto aborted;
+                  }
+                  else
+                  {
+                     if (handler->dbl && !handler->dbl (dbl, user_data))
+                        goto aborted;
+                  }
 
-                     case '[':
+                  break;
+            };
 
-                        if (!new_value (&state, &top, &root, &alloc, json_array))
-                           goto e_alloc_failure;
+            sax->expect = sax->depth ? sax_need_comma : sax_done;
+            continue;
+      };
 
-                        flags |= flag_seek_value;
-                        continue;
+      /* `}` or `]` closing the innermost container */
 
-                     case '"':
+      if (sax->stack [sax->depth - 1] != (*ptr == '}' ? json_object : json_array))
+      {  sprintf (sax->error, "%u:%u: Unexpected `%c`", sax_line_and_col (ptr), *ptr);
+         return 0;
+      }
 
-                        if (!new_value (&state, &top, &root, &alloc, json_string))
-                           goto e_alloc_failure;
+      -- sax->depth;
+      ++ ptr;
 
-                        flags |= flag_string;
+      if (*token == '}')
+      {
+         if (handler->object_end && !handler->object_end (user_data))
+            goto aborted;
+      }
+      else
+      {
+         if (handler->array_end && !handler->array_end (user_data))
+            goto aborted;
+      }
 
-                        string = top->u.string.ptr;
-                        string_length = 0;
+      sax->expect = sax->depth ? sax_need_comma : sax_done;
+   }
 
-                        continue;
+aborted:
 
-                     case 't':
+   sprintf (sax->error, "%u:%u: Aborted by handler", sax_line_and_col (token));
+   return 0;
+}
 
-                        if ((end - state.ptr) <= 3 || *(++ state.ptr) != 'r' ||
-                            *(++ state.ptr) != 'u' || *(++ state.ptr) != 'e')
-                        {
-                           goto e_unknown_value;
-                        }
+static void sax_init (json_sax_state * sax, json_settings * settings,
+                      json_sax_handler * handler)
+{
+   memset (sax, 0, sizeof (*sax));
 
-                        if (!new_value (&state, &top, &root, &alloc, json_boolean))
-                           goto e_alloc_failure;
+   memcpy (&sax->state.settings, settings, sizeof (json_settings));
+   memcpy (&sax->handler, handler, sizeof (json_sax_handler));
 
-                        top->u.boolean = 1;
+   if (!sax->state.settings.mem_alloc)
+      sax->state.settings.mem_alloc = default_alloc;
 
-                        flags |= flag_next;
-                        break;
+   if (!sax->state.settings.mem_free)
+      sax->state.settings.mem_free = default_free;
 
-                     case 'f':
+   sax->state.cur_line = 1;
+   sax->expect = sax_seek_value;
+}
 
-                        if ((end - state.ptr) <= 4 || *(++ state.ptr) != 'a' ||
-                            *(++ state.ptr) != 'l' || *(++ state.ptr) != 's' ||
-                            *(++ state.ptr) != 'e')
-                        {
-                           goto e_unknown_value;
-                        }
+static void sax_free (json_sax_state * sax)
+{
+   if (sax->stack)
+      sax->state.settings.mem_free (sax->stack, sax->state.settings.user_data);
 
-                        if (!new_value (&state, &top, &root, &alloc, json_boolean))
-                           goto e_alloc_failure;
+   if (sax->scratch)
+      sax->state.settings.mem_free (sax->scratch, sax->state.settings.user_data);
+}
 
-                        flags |= flag_next;
-                        break;
+int json_sax_parse (json_settings * settings,
+                    json_sax_handler * handler,
+                    const json_char * json,
+                    size_t length,
+                    char * error_buf)
+{
+   json_sax_state sax;
+   int success;
 
-                     case 'n':
+   /* Skip UTF-8 BOM
+    */
+   if (length >= 3 && ((unsigned char) json [0]) == 0xEF
+                   && ((unsigned char) json [1]) == 0xBB
+                   && ((unsigned char) json [2]) == 0xBF)
+   {
+      json += 3;
+      length -= 3;
+   }
 
-                        if ((end - state.ptr) <= 3 || *(++ state.ptr) != 'u' ||
-                            *(++ state.ptr) != 'l' || *(++ state.ptr) != 'l')
-                        {
-                           goto e_unknown_value;
-                        }
+   sax_init (&sax, settings, handler);
+   sax.line_start = json;
+   scanner_init (&sax.scanner, json);
 
-                        if (!new_value (&state, &top, &root, &alloc, json_null))
-                           goto e_alloc_failure;
+   success = (sax_run (&sax, json, json + length, 1) != 0);
 
-                        flags |= flag_next;
-                        break;
+   if (!success && error_buf)
+      strcpy (error_buf, *sax.error ? sax.error : "Unknown error");
 
-                     default:
+   sax_free (&sax);
 
-                        if (isdigit ((unsigned char) b) || b == '-')
-                        {
-                           if (!new_value (&state, &top, &root, &alloc, json_integer))
-                              goto e_alloc_failure;
+   return success;
+}
 
-                           if (!state.first_pass)
-                           {
-                              while (isdigit ((unsigned char) b) || b == '+' || b == '-'
-                                        || b == 'e' || b == 'E' || b == '.')
-                              {
-                                 if ( (++ state.ptr) == end)
-                                 {
-                                    b = 0;
-                                    break;
-                                 }
-
-                                 b = *state.ptr;
-                              }
+/* Incremental decoding
+ *
+ * The caller keeps the input: each feed decodes what it can and reports how
+ * much it consumed, and the unconsumed rest (the start of a token cut off by
+ * the end of the buffer) is passed again at the front of the next feed.
+ */
 
-                              flags |= flag_next | flag_reproc;
-                              break;
-                           }
+struct _json_sax_stream
+{
+   json_sax_state sax;
 
-                           flags &= ~ (flag_num_negative | flag_num_e |
-                                        flag_num_e_got_sign | flag_num_e_negative |
-                                           flag_num_zero);
+   int started;    /* BOM skipped, line_start set */
+   size_t column;  /* of the first unconsumed char */
+};
 
-                           num_digits = 0;
-                           num_fraction = 0;
-                           num_e = 0;
+json_sax_stream * json_sax_stream_new (json_settings * settings,
+                                       json_sax_handler * handler)
+{
+   json_sax_stream * stream;
+   void * (* mem_alloc) (size_t, int, void *) =
+      settings->mem_alloc ? settings->mem_alloc : default_alloc;
 
-                           if (b != '-')
-                           {
-                              flags |= flag_reproc;
-                              break;
-                           }
+   if (! (stream = (json_sax_stream *) mem_alloc
+            (sizeof (json_sax_stream), 1, settings->user_data)))
+   {
+      return 0;
+   }
 
-                           flags |= flag_num_negative;
-                           continue;
-                        }
-                        else
-                        {  sprintf (error, "%u:%u: Unexpected `%c` when seeking value", line_and_col, b);
-                           goto e_failed;
-                        }
-                  };
-            };
-         }
-         else
-         {
-            switch (top->type)
-            {
-            case json_object:
+   sax_init (&stream->sax, settings, handler);
+   stream->started = 0;
+   stream->column = 0;
 
-               switch (b)
-               {
-                  whitespace:
-                     continue;
+   return stream;
+}
 
-                  case '"':
+static int sax_feed (json_sax_stream * stream, const json_char * json,
+                     size_t length, int final, size_t * consumed,
+                     char * error_buf)
+{
+   json_sax_state * sax = &stream->sax;
+   const json_char * start = json, * stop;
 
-                     if (flags & flag_need_comma)
-                     {  sprintf (error, "%u:%u: Expected `,` before `\"`", line_and_col);
-                        goto e_failed;
-                     }
+   if (!stream->started)
+   {
+      /* Skip UTF-8 BOM, which might itself be split
+       */
+      if (length < 3 && !final && !memcmp (json, "\xEF\xBB\xBF", length))
+      {
+         *consumed = 0;
+         return 1;
+      }
 
-                     flags |= flag_string;
+      if (length >= 3 && ((unsigned char) json [0]) == 0xEF
+                      && ((unsigned char) json [1]) == 0xBB
+                      && ((unsigned char) json [2]) == 0xBF)
+      {
+         json += 3;
+         length -= 3;
+      }
 
-                     string = (json_char *) top->_reserved.object_mem;
-                     string_length = 0;
+      stream->started = 1;
+   }
 
-                     break;
+   /* the buffer moved, so the line being decoded starts `column` before it */
+   sax->line_start = json - stream->column;
+   scanner_init (&sax->scanner, json);
 
-                  case '}':
+   if (! (stop = sax_run (sax, json, json + length, final)))
+   {
+      if (error_buf)
+         strcpy (error_buf, *sax->error ? sax->error : "Unknown error");
 
-                     flags = (flags & ~ flag_need_comma) | flag_next;
-                     break;
+      return 0;
+   }
 
-                  case ',':
+   stream->column = stop - sax->line_start;
+   *consumed = stop - start;
 
-                     if (flags & flag_need_comma)
-                     {
-                        flags &= ~ flag_need_comma;
-                        break;
-                     } /* FALLTHRU */
+   return 1;
+}
 
-                  default:
-                     sprintf (error, "%u:%u: Unexpected `%c` in object", line_and_col, b);
-                     goto e_failed;
-               };
+int json_sax_feed (json_sax_stream * stream,
+                   const json_char * json,
+                   size_t length,
+                   size_t * consumed,
+                   char * error)
+{
+   return sax_feed (stream, json, length, 0, consumed, error);
+}
 
-               break;
+int json_sax_finish (json_sax_stream * stream,
+                     const json_char * json,
+                     size_t length,
+                     char * error)
+{
+   size_t consumed;
 
-            case json_integer:
-            case json_double:
+   return sax_feed (stream, json, length, 1, &consumed, error);
+}
 
-               if (isdigit ((unsigned char)b))
-               {
-                  ++ num_digits;
+void json_sax_stream_free (json_sax_stream * stream)
+{
+   json_settings * settings = &stream->sax.state.settings;
 
-                  if (top->type == json_integer || flags & flag_num_e)
-                  {
-                     if (! (flags & flag_num_e))
-                     {
-                        if (flags & flag_num_zero)
-                        {  sprintf (error, "%u:%u: Unexpected `0` before `%c`", line_and_col, b);
-                           goto e_failed;
-                        }
+   sax_free (&stream->sax);
+   settings->mem_free (stream, settings->user_data);
+}
 
-                        if (num_digits == 1 && b == '0')
-                           flags |= flag_num_zero;
-                     }
-                     else
-                     {
-                        flags |= flag_num_e_got_sign;
-                        num_e = (num_e * 10) + (b - '0');
-                        continue;
-                     }
+/* Single-pass tree building
+ *
+ * Builds the same tree as json_parse_ex from the SAX events.  The children
+ * of each open array or object are collected per depth and copied into an
+ * exactly sized block when it ends, laid out as the two-pass parser lays
+ * them out, so json_value_free_ex works on the result as usual.
+ */
 
-                     if (would_overflow(top->u.integer, b))
-                     {
-                        json_int_t integer = top->u.integer;
-                        -- num_digits;
-                        -- state.ptr;
-                        top->type = json_double;
-                        top->u.dbl = (double)integer;
-                        continue;
-                     }
+typedef struct
+{
+   json_value * value;
+   size_t length;
 
-                     top->u.integer = (top->u.integer * 10) + (b - '0');
-                     continue;
-                  }
+   /* arrays: values until the array ends */
+   json_value ** items;
+   size_t items_size;
 
-                  if (flags & flag_num_got_decimal)
-                     num_fraction = (num_fraction * 10) + (b - '0');
-                  else
-                     top->u.dbl = (top->u.dbl * 10) + (b - '0');
+   /* objects: entries and key names until the object ends */
+   json_object_entry * entries;
+   size_t entries_size;
 
-                  continue;
-               }
+   json_char * names;
+   size_t names_length, names_size;
 
-               if (b == '+' || b == '-')
-               {
-                  if ( (flags & flag_num_e) && !(flags & flag_num_e_got_sign))
-                  {
-                     flags |= flag_num_e_got_sign;
+} json_builder_frame;
 
-                     if (b == '-')
-                        flags |= flag_num_e_negative;
+typedef struct
+{
+   json_state state;
 
-                     continue;
-                  }
-               }
-               else if (b == '.' && top->type == json_integer)
-               {
-                  json_int_t integer = top->u.integer;
+   json_value * root;
 
-                  if (!num_digits)
-                  {  sprintf (error, "%u:%u: Expected digit before `.`", line_and_col);
-                     goto e_failed;
-                  }
+   json_builder_frame * frames;
+   size_t depth, frames_size;
 
-                  top->type = json_double;
-                  top->u.dbl = (double) integer;
+   int alloc_failed;
 
-                  flags |= flag_num_got_decimal;
-                  num_digits = 0;
-                  continue;
-               }
+} json_builder;
 
-               if (! (flags & flag_num_e))
-               {
-                  if (top->type == json_double)
-                  {
-                     if (!num_digits)
-                     {  sprintf (error, "%u:%u: Expected digit after `.`", line_and_col);
-                        goto e_failed;
-                     }
+static json_value * builder_value (json_builder * builder, json_type type)
+{
+   json_builder_frame * frame;
+   json_value * value;
 
-                     top->u.dbl += num_fraction / pow (10.0, num_digits);
-                  }
+   if (! (value = (json_value *) json_alloc
+         (&builder->state, sizeof (json_value) + builder->state.settings.value_extra, 1)))
+   {
+      builder->alloc_failed = 1;
+      return 0;
+   }
 
-                  if (b == 'e' || b == 'E')
-                  {
-                     flags |= flag_num_e;
+   value->type = type;
 
-                     if (top->type == json_integer)
-                     {
-                        json_int_t integer = top->u.integer;
-                        top->type = json_double;
-                        top->u.dbl = (double) integer;
-                     }
+   if (!builder->depth)
+   {
+      builder->root = value;
+      return value;
+   }
 
-                     num_digits = 0;
-                     flags &= ~ flag_num_zero;
+   frame = &builder->frames [builder->depth - 1];
+   value->parent = frame->value;
 
-                     continue;
-                  }
-               }
-               else
-               {
-                  if (!num_digits)
-                  {  sprintf (error, "%u:%u: Expected digit after `e`", line_and_col);
-                     goto e_failed;
-                  }
+   if (frame->value->type == json_array)
+   {
+      if (!json_reserve (&builder->state, (void **) &frame->items,
+                         &frame->items_size, frame->length + 1, sizeof (json_value *)))
+      {
+         builder->state.settings.mem_free (value, builder->state.settings.user_data);
+         builder->alloc_failed = 1;
+         return 0;
+      }
 
-                  top->u.dbl *= pow (10.0, (flags & flag_num_e_negative ? - num_e : num_e));
-               }
+      frame->items [frame->length ++] = value;
+   }
+   else
+   {
+      frame->entries [frame->length - 1].value = value;
+   }
 
-               if (flags & flag_num_negative)
-               {
-                  if (top->type == json_integer)
-                     top->u.integer = - top->u.integer;
-                  else
-                     top->u.dbl = - top->u.dbl;
-               }
+   return value;
+}
 
-               flags |= flag_next | flag_reproc;
-               break;
+static int builder_push (json_builder * builder, json_type type)
+{
+   json_builder_frame * frame;
+   json_value * value;
+   size_t frames_size = builder->frames_size;
 
-            default:
-               break;
-            };
-         }
+   if (! (value = builder_value (builder, type)))
+      return 0;
 
-         if (flags & flag_reproc)
-         {
-            flags &= ~ flag_reproc;
-            -- state.ptr;
-         }
+   if (!json_reserve (&builder->state, (void **) &builder->frames, &builder->frames_size,
+                      builder->depth + 1, sizeof (json_builder_frame)))
+   {
+      builder->alloc_failed = 1;
+      return 0;
+   }
 
-         if (flags & flag_next)
-         {
-            flags = (flags & ~ flag_next) | flag_need_comma;
+   if (builder->frames_size > frames_size)
+   {
+      memset (builder->frames + frames_size, 0,
+              (builder->frames_size - frames_size) * sizeof (json_builder_frame));
+   }
 
-            if (!top->parent)
-            {
-               /* root value done */
+   /* the buffers are kept for the next container at this depth */
+   frame = &builder->frames [builder->depth ++];
+   frame->value = value;
+   frame->length = 0;
+   frame->names_length = 0;
 
-               flags |= flag_done;
-               continue;
-            }
+   return 1;
+}
 
-            if (top->parent->type == json_array)
-               flags |= flag_seek_value;
+static int builder_object_begin (void * user_data)
+{
+   return builder_push ((json_builder *) user_data, json_object);
+}
 
-            if (!state.first_pass)
-            {
-               json_value * parent = top->parent;
+static int builder_array_begin (void * user_data)
+{
+   return builder_push ((json_builder *) user_data, json_array);
+}
 
-               switch (parent->type)
-               {
-                  case json_object:
+static int builder_array_end (void * user_data)
+{
+   json_builder * builder = (json_builder *) user_data;
+   json_builder_frame * frame = &builder->frames [builder->depth - 1];
+   json_value * value = frame->value;
 
-                     parent->u.object.values
-                        [parent->u.object.length].value = top;
+   if (frame->length)
+   {
+      if (! (value->u.array.values = (json_value **) json_alloc
+               (&builder->state, frame->length * sizeof (json_value *), 0)))
+      {
+         builder->alloc_failed = 1;
+         return 0;
+      }
 
-                     break;
+      memcpy (value->u.array.values, frame->items, frame->length * sizeof (json_value *));
+      value->u.array.length = frame->length;
+   }
 
-                  case json_array:
+   frame->length = 0;
+   -- builder->depth;
 
-                     parent->u.array.values
-                           [parent->u.array.length] = top;
+   return 1;
+}
 
-                     break;
+static int builder_object_end (void * user_data)
+{
+   json_builder * builder = (json_builder *) user_data;
+   json_builder_frame * frame = &builder->frames [builder->depth - 1];
+   json_value * value = frame->value;
+   json_char * names;
+   size_t values_size = sizeof (json_object_entry) * frame->length, i;
 
-                  default:
-                     break;
-               };
-            }
+   if (frame->length)
+   {
+      if (! (value->u.object.values = (json_object_entry *) json_alloc
+               (&builder->state, values_size + frame->names_length, 0)))
+      {
+         builder->alloc_failed = 1;
+         return 0;
+      }
 
-            if ( (++ top->parent->u.array.length) > UINT_MAX - 8)
-               goto e_overflow;
+      memcpy (value->u.object.values, frame->entries, values_size);
 
-            top = top->parent;
+      names = (json_char *) (((char *) value->u.object.values) + values_size);
+      memcpy (names, frame->names, frame->names_length);
 
-            continue;
-         }
+      for (i = 0; i < frame->length; ++ i)
+      {
+         value->u.object.values [i].name = names;
+         names += value->u.object.values [i].name_length + 1;
       }
 
-      alloc = root;
+      value->_reserved.object_mem = (void *) names;
+      value->u.object.length = frame->length;
    }
 
-   return root;
-
-e_unknown_value:
+   frame->length = 0;
+   -- builder->depth;
 
-   sprintf (error, "%u:%u: Unknown value", line_and_col);
-   goto e_failed;
+   return 1;
+}
 
-e_alloc_failure:
+static int builder_key (const json_char * name, unsigned int name_length, void * user_data)
+{
+   json_builder * builder = (json_builder *) user_data;
+   json_builder_frame * frame = &builder->frames [builder->depth - 1];
 
-   strcpy (error, "Memory allocation failure");
-   goto e_failed;
+   if (!json_reserve (&builder->state, (void **) &frame->entries, &frame->entries_size,
+                      frame->length + 1, sizeof (json_object_entry))
+         || !json_reserve (&builder->state, (void **) &frame->names, &frame->names_size,
+                           frame->names_length + name_length + 1, sizeof (json_char)))
+   {
+      builder->alloc_failed = 1;
+      return 0;
+   }
 
-e_overflow:
+   memcpy (frame->names + frame->names_length, name, (name_length + 1) * sizeof (json_char));
+   frame->names_length += name_length + 1;
 
-   sprintf (error, "%u:%u: Too long (caught overflow)", line_and_col);
-   goto e_failed;
+   frame->entries [frame->length].name = 0;
+   frame->entries [frame->length].name_length = name_length;
+   frame->entries [frame->length ++].value = 0;
 
-e_failed:
+   return 1;
+}
 
-   if (error_buf)
-   {
-      if (*error)
-         strcpy (error_buf, error);
-      else
-         strcpy (error_buf, "Unknown error");
-   }
+static int builder_string (const json_char * ptr, unsigned int length, void * user_data)
+{
+   json_builder * builder = (json_builder *) user_data;
+   json_value * value;
 
-   if (state.first_pass)
-      alloc = root;
+   if (! (value = builder_value (builder, json_string)))
+      return 0;
 
-   while (alloc)
+   if (! (value->u.string.ptr = (json_char *) json_alloc
+            (&builder->state, (length + 1) * sizeof (json_char), 0)))
    {
-      top = alloc->_reserved.next_alloc;
-      state.settings.mem_free (alloc, state.settings.user_data);
-      alloc = top;
+      builder->alloc_failed = 1;
+      return 0;
    }
 
-   if (!state.first_pass)
-      json_value_free_ex (&state.settings, root);
+   memcpy (value->u.string.ptr, ptr, (length + 1) * sizeof (json_char));
+   value->u.string.length = length;
 
-   return 0;
+   return 1;
 }
 
-json_value * json_parse (const json_char * json, size_t length)
+static int builder_integer (json_int_t integer, void * user_data)
 {
-   json_settings settings = { 0 };
-   return json_parse_ex (&settings, json, length, 0);
+   json_value * value;
+
+   if (! (value = builder_value ((json_builder *) user_data, json_integer)))
+      return 0;
+
+   value->u.integer = integer;
+   return 1;
 }
 
-void json_value_free_ex (json_settings * settings, json_value * value)
+static int builder_dbl (double dbl, void * user_data)
 {
-   json_value * cur_value;
+   json_value * value;
 
-   if (!value)
-      return;
+   if (! (value = builder_value ((json_builder *) user_data, json_double)))
+      return 0;
 
-   value->parent = 0;
+   value->u.dbl = dbl;
+   return 1;
+}
 
-   while (value)
-   {
-      switch (value->type)
-      {
-         case json_array:
+static int builder_boolean (int boolean, void * user_data)
+{
+   json_value * value;
 
-            if (!value->u.array.length)
-            {
-               settings->mem_free (value->u.array.values, settings->user_data);
-               break;
-            }
+   if (! (value = builder_value ((json_builder *) user_data, json_boolean)))
+      return 0;
 
-            value = value->u.array.values [-- value->u.array.length];
-            continue;
+   value->u.boolean = boolean;
+   return 1;
+}
 
-         case json_object:
+static int builder_null (void * user_data)
+{
+   return builder_value ((json_builder *) user_data, json_null) != 0;
+}
 
-            if (!value->u.object.length)
-            {
-               settings->mem_free (value->u.object.values, settings->user_data);
-               break;
-            }
+static json_value * parse_single_pass (json_settings * settings,
+                                       const json_char * json,
+                                       size_t length,
+                                       char * error_buf)
+{
+   json_builder builder;
+   json_sax_handler handler;
+   json_builder_frame * frame;
+   json_settings * state_settings = &builder.state.settings;
+   size_t i, entry;
+   int success;
+
+   memset (&builder, 0, sizeof (builder));
+   memcpy (state_settings, settings, sizeof (json_settings));
+
+   if (!state_settings->mem_alloc)
+      state_settings->mem_alloc = default_alloc;
+
+   if (!state_settings->mem_free)
+      state_settings->mem_free = default_free;
+
+   memset (&handler, 0, sizeof (handler));
+
+   handler.object_begin = builder_object_begin;
+   handler.object_end = builder_object_end;
+   handler.array_begin = builder_array_begin;
+   handler.array_end = builder_array_end;
+   handler.key = builder_key;
+   handler.string = builder_string;
+   handler.integer = builder_integer;
+   handler.dbl = builder_dbl;
+   handler.boolean = builder_boolean;
+   handler.null = builder_null;
+   handler.user_data = &builder;
+
+   success = json_sax_parse (settings, &handler, json, length, error_buf);
+
+   if (!success && builder.alloc_failed && error_buf)
+      strcpy (error_buf, "Memory allocation failure");
+
+   /* containers that didn't end still hold their values in the frames */
+   for (i = builder.depth; !success && i > 0; -- i)
+   {
+      frame = &builder.frames [i - 1];
 
-            value = value->u.object.values [-- value->u.object.length].value;
-            continue;
+      for (entry = 0; entry < frame->length; ++ entry)
+      {
+         json_value_free_ex (state_settings, frame->value->type == json_array ?
+                             frame->items [entry] : frame->entries [entry].value);
+      }
+   }
 
-         case json_string:
+   for (i = 0; i < builder.frames_size; ++ i)
+   {
+      frame = &builder.frames [i];
 
-            settings->mem_free (value->u.string.ptr, settings->user_data);
-            break;
+      if (frame->items)
+         state_settings->mem_free (frame->items, state_settings->user_data);
 
-         default:
-            break;
-      };
+      if (frame->entries)
+         state_settings->mem_free (frame->entries, state_settings->user_data);
 
-      cur_value = value;
-      value = value->parent;
-      settings->mem_free (cur_value, settings->user_data);
+      if (frame->names)
+         state_settings->mem_free (frame->names, state_settings->user_data);
    }
-}
 
-void json_value_free (json_value * value)
-{
-   json_settings settings = { 0 };
-   settings.mem_free = default_free;
-   json_value_free_ex (&settings, value);
+   if (builder.frames)
+      state_settings->mem_free (builder.frames, state_settings->user_data);
+
+   if (!success)
+   {
+      json_value_free_ex (state_settings, builder.root);
+      return 0;
+   }
+
+   return builder.root;
 }
@@ -81,6 +81,7 @@ typedef struct
 } json_settings;
 
 #define json_enable_comments  0x01
+#define json_single_pass      0x02  /* build the tree in one pass over the input */
 
 typedef enum
 {
@@ -282,6 +283,115 @@ void json_value_free_ex (json_settings * settings,
                          json_value *);
 
 
+/* Bump-pointer arena for the mem_alloc/mem_free hooks.  Every value, vector
+ * and string of a parse is carved out of one block, json_value_free_ex
+ * becomes unnecessary and json_arena_reset releases them all at once.
+ */
+typedef struct _json_arena_block json_arena_block;
+
+typedef struct
+{
+   json_arena_block * blocks;  /* current block first */
+   size_t block_size;
+
+} json_arena;
+
+/* Sizes the first block for a document of json_length bytes.  Returns 0 if
+ * the block couldn't be allocated.
+ */
+int json_arena_init (json_arena * arena, size_t json_length);
+
+/* Points mem_alloc, mem_free and user_data of settings at the arena */
+void json_arena_settings (json_arena * arena, json_settings * settings);
+
+/* Drops every allocation made so far, keeping the memory for the next
+ * parse.  A document that didn't fit in one block leaves one block big
+ * enough for all of it.
+ */
+void json_arena_reset (json_arena * arena);
+
+void json_arena_free (json_arena * arena);
+
+
+/* Event (SAX-style) decoding: no json_value tree is built, each value is
+ * reported through the handler as soon as it has been decoded.
+ *
+ * Any callback may be left null.  Returning 0 from a callback aborts the
+ * parse.  Strings and keys are null terminated and only valid for the
+ * duration of the callback.
+ */
+typedef struct
+{
+   int (* object_begin) (void * user_data);
+   int (* object_end) (void * user_data);
+
+   int (* array_begin) (void * user_data);
+   int (* array_end) (void * user_data);
+
+   int (* key) (const json_char * name, unsigned int name_length, void * user_data);
+   int (* string) (const json_char * ptr, unsigned int length, void * user_data);
+
+   int (* integer) (json_int_t, void * user_data);
+   int (* dbl) (double, void * user_data);
+   int (* boolean) (int, void * user_data);
+   int (* null) (void * user_data);
+
+   /* Optional fast path for arrays of [integer, number] pairs such as time
+    * series.  Runs of such elements are delivered in batches as two packed
+    * columns instead of array_begin, integer, integer/dbl and array_end for
+    * each pair, the second member converted to double.  An array may take
+    * several batches, interleaved with the usual events for any element of
+    * another shape.  With json_sax_feed, a pair that's cut off by the end of
+    * the input it was given also comes as the usual events, the batches
+    * pick up again from the next whole pair.
+    */
+   int (* series) (const json_int_t * first, const double * second,
+                   size_t count, void * user_data);
+
+   void * user_data;  /* will be passed to every callback */
+
+} json_sax_handler;
+
+/* Returns 1 on success, 0 on failure (with the reason in error, which
+ * must hold json_error_max chars, if not null).
+ */
+int json_sax_parse (json_settings * settings,
+                    json_sax_handler * handler,
+                    const json_char * json,
+                    size_t length,
+                    char * error);
+
+
+/* Incremental event decoding, for input that arrives in pieces.
+ *
+ * json_sax_feed decodes as much of the input as it can and sets *consumed.
+ * Whatever wasn't consumed is the start of a value cut off by the end of the
+ * input, and must be passed again at the front of the next call, followed
+ * by the input that came after it.  json_sax_finish takes the rest of the
+ * input and checks that the document is complete.
+ *
+ * Both return 1 on success and 0 on failure, as json_sax_parse does.  Once
+ * either fails, the stream can only be freed.
+ */
+typedef struct _json_sax_stream json_sax_stream;
+
+json_sax_stream * json_sax_stream_new (json_settings * settings,
+                                       json_sax_handler * handler);
+
+int json_sax_feed (json_sax_stream * stream,
+                   const json_char * json,
+                   size_t length,
+                   size_t * consumed,
+                   char * error);
+
+int json_sax_finish (json_sax_stream * stream,
+                     const json_char * json,
+                     size_t length,
+                     char * error);
+
+void json_sax_stream_free (json_sax_stream * stream);
+
+
 #ifdef __cplusplus
    } /* extern "C" */
 #endif
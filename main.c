@@ -21,21 +21,54 @@
                     apt-get install libcurl4-openssl-dev
                     apt-get install libcurl4-nss-dev
                   
-    Compiling:  gcc -Wall -lm -lcurl timedate.c curl_helpers.c json.c main.c -o moneymaker
+    Compiling:  gcc -Wall -lm -lcurl timedate.c curl_helpers.c json.c series.c cache.c bars.c main.c -o moneymaker
     
-    Running: ./moneymaker [coin] [date_begin] [date_end]
+    Testing:    sh tests/run.sh builds the program and the tests into tests/build and runs them, some need python3
+    
+    Running: ./moneymaker [-j max_concurrent] [-r requests_per_minute] [-R record_dir | -P replay_dir] [-C cache_dir] [-B bar_size] [coin[,coin...]] [date_begin] [date_end]
             e.g. ./moneymaker monero 2021-01-01 2021-06-30
+            Several coins are fetched at the same time, at most max_concurrent (default 8) at once,
+            and each one's results are printed as soon as its data is in
+            e.g. ./moneymaker -j 4 bitcoin,monero,ethereum 2021-01-01 2021-06-30
+            Requests are kept under requests_per_minute (default 30, 0 for no limit) in the order the coins are listed.
+            When the API is busy or rate limits anyway they are retried after a backoff or the time it asks for
+            -R saves every response to record_dir, named by coin, currency and range. -P serves them from there
+            instead, with no network, e.g. for benchmarks or offline runs of the same query
+            e.g. ./moneymaker -R saved monero 2021-01-01 2021-06-30 && ./moneymaker -P saved monero 2021-01-01 2021-06-30
+            -C keeps each coin's series in cache_dir/coin-eur.bin, a binary file that's mapped as is. A query within
+            a cached range is answered from it without any download or json. One that starts within it only fetches
+            the rest and appends it to the cache, e.g. refreshing up to today. Other queries replace it
+            -B also prints the range as bars of 5m, 1h, 4h, 1d or 1w, resampled from the data as it came in: one tab
+            separated line per bar with its start, open, high, low, close, volume and volume weighted average price
+            e.g. ./moneymaker -B 4h bitcoin 2021-01-01 2021-01-31
+    Bench:   ./moneymaker -T
+            Times the exercises and the bucketing into days over made up series from 4096 to some 4 million points,
+            doubling each time. The time per point should stay about the same, i.e. they scale linearly
+    Batch:   ./moneymaker [options] -b queries_file (- for stdin)
+            Runs every query in the file in one process, sharing connections, caches and buffers. One query per line:
+            coin date_begin date_end [principal], empty lines and ones starting with # are skipped.
+            Prints one tab separated record per query as it's done, progress and errors go to stderr:
+            coin, date_begin, date_end, status (ok, failed or nodata) and for ok the longest bear trend's days, first and
+            last date, the highest trading volume and its date, the best deal's ROI pct, buy and sell dates (- for no deal)
+            Overlapping queries of a coin longer than a day are fetched once, as one range that covers them all.
+            e.g. printf "bitcoin 2021-01-01 2021-06-30\nmonero 2021-01-01 2021-03-31 500\n" | ./moneymaker -b -
+    Server:  ./moneymaker [options] -s socket_path
+            Listens on a unix socket for the same query lines and answers each with a batch record. The series it
+            fetches are kept in memory and overlapping ranges of a coin merged, so queries within them are answered
+            without the API. A query that needs fetching doesn't hold up the other clients, each client's answers come
+            in the order it sent the queries
+            e.g. ./moneymaker -s /tmp/moneymaker.sock & echo "bitcoin 2021-01-01 2021-06-30" | nc -U /tmp/moneymaker.sock
+            The API can be swapped for e.g. a local test server by setting MONEYMAKER_API_URL
+            e.g. MONEYMAKER_API_URL=http://127.0.0.1:8000/api/v3 ./moneymaker monero 2021-01-01 2021-06-30
 
     Copyright: main.c and timedate.c/.h are released to the public domain in so far as they can be
                Adapted maybe a dozen lines from a curl library sample code (MIT license?)
                Using the json library (BSD license)
                
     Additional information:
-               Daily data for at least 2015-01-28 is missing and any query that includes it gets weird.
-                At least it fails gracefully but the data / date is off by one and wasn't fixed this late to the deadline (2021-12-31)
-                The proper way would probably be to calculate the dates from timestamps of the data instead of the array index
-                And also should verify daily data and their timestamps that they land on the same day
-                Or skip over the entry in the array and add checks for exercises that skip empty days..
+               Daily data for at least 2015-01-28 is missing. The days are found from the timestamps of the data
+                instead of the array index, so the dates after a missing day stay right. Missing days are marked in a bitmap
+                and the exercises skip them, e.g. a down trend goes on from the day before the gap to the day after it.
 
  */
  
@@ -45,86 +78,151 @@
 #include <stdint.h>
 #include <time.h>
 #include <string.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <curl/curl.h>
 
 #include "json.h"
 #include "curl_helpers.h"
 #include "timedate.h"
+#include "series.h"
+#include "cache.h"
+#include "bars.h"
 
 /* uncomment to enable debug printing */
 /* #define DEBUG 1 */
 
+/* overridden by the MONEYMAKER_API_URL environment variable */
+#define API_URL "https://api.coingecko.com/api/v3"
+
+/* clients the server keeps connections to at the same time */
+#define SERVER_MAX_CLIENTS 64
+
+/* data's columns start on this boundary, so that none of them shares a cache line with another */
+#define DATA_ALIGN 64
+
+/* the benchmark doubles its series from the least to the most points, the most are some 40 years of 5 minute data */
+#define BENCH_MIN_POINTS (1 << 12)
+#define BENCH_MAX_POINTS (1 << 22)
+
 struct pair_t {
     double buy_price;
     double sell_price;
-    uint8_t buy_date;
-    uint8_t sell_date;
+    size_t buy_date;
+    size_t sell_date;
+};
+
+/* what the exercises found, days as indexes from date_begin */
+struct results_t {
+    /* A: longest down trend */
+    size_t trend_days;
+    size_t trend_start;
+    size_t trend_stop;
+    /* B: highest trading volume */
+    double highest_volume;
+    size_t volume_day;
+    /* C: the best deal, sell_price 0 if there's none */
+    struct pair_t trade;
 };
 
+/* progress, warnings and errors. stdout, unless it's taken by batch records */
+static FILE *messages;
+
 struct data_t { 
     int64_t begin_timestamp;
     int64_t end_timestamp;
     struct date_yyyymmdd_t date_begin;
     struct date_yyyymmdd_t date_end;
-    uint16_t num_entries;
+    size_t num_entries;
     int64_t *timestamp;
     double *price;
     double *volume;
     double *market_cap;
+    /* a bit per day, set if the day had data. the days are a grid of midnights from begin_timestamp
+       and the values of the ones without data are only placeholders */
+    uint64_t *valid;
+    /* all of the above columns are in one block */
+    void *block;
 };
 
-int8_t exercise_a (struct data_t *data) {
+/* the first day from i on, but before end, that has data. scans the bitmap a word at a time */
+static inline size_t next_valid (const uint64_t *valid, size_t i, size_t end) {
+    size_t word = i / 64;
+    uint64_t bits;
+    
+    if (i >= end) {
+        return end;
+    }
+    bits = valid[word] & (~(uint64_t) 0 << (i % 64));
+    while (bits == 0) {
+        word++;
+        if (word * 64 >= end) {
+            return end;
+        }
+        bits = valid[word];
+    }
+    i = word * 64 + __builtin_ctzll(bits);
+    
+    return (i < end) ? i : end;
+}
+
+int8_t exercise_a (struct data_t *data, struct results_t *results) {
     /*
      * Exercise A: calculate longest down trend for the given date range
      * Expected output: The maximum amount of days bitcoin’s price was decreasing in a row.
      */
-    uint16_t days = 0;
-    uint16_t max_days = 0;
-    uint16_t max_start = 0;
-    uint16_t max_stop = 0;
-    uint16_t start = 0;
-    
-    struct date_yyyymmdd_t date_start;
-    struct date_yyyymmdd_t date_stop;
+    size_t days = 0;
+    size_t max_days = 0;
+    size_t max_start = 0;
+    size_t max_stop = 0;
+    size_t prev = next_valid(data->valid, 0, data->num_entries);
+    size_t start = prev;
     
-    for (uint16_t i = 0; i < data->num_entries - 1; i++) {
-        if (data->price[i + 1] < data->price[i]) {
+    /* each day with data against the previous one that had it */
+    for (size_t i = next_valid(data->valid, prev + 1, data->num_entries); i < data->num_entries;
+         prev = i, i = next_valid(data->valid, i + 1, data->num_entries)) {
+        if (data->price[i] < data->price[prev]) {
             days++;
         } else {
             if (days > max_days) {
                 max_days = days;
-                max_stop = i;
+                max_stop = prev;
                 max_start = start;
             }
             days = 0;
-            start = i + 1;
+            start = i;
         }
     }
     
 #if DEBUG
-    printf("start: %d\tstop: %d\tdays: %d\n", max_start, max_stop, max_days);
+    printf("start: %zu\tstop: %zu\tdays: %zu\n", max_start, max_stop, max_days);
 #endif
 
-    add_days_to_date(&(data->date_begin), &date_start, max_start);
-    add_days_to_date(&(data->date_begin), &date_stop, max_stop);
-    printf("Longest bear trend of %d days between %04d-%02d-%02d and %04d-%02d-%02d\n",
-           max_days, date_start.year, date_start.month, date_start.day, date_stop.year, date_stop.month, date_stop.day);
+    results->trend_days = max_days;
+    results->trend_start = max_start;
+    results->trend_stop = max_stop;
 
     return 0;
 }
 
-int8_t exercise_b (struct data_t *data) {
+int8_t exercise_b (struct data_t *data, struct results_t *results) {
 
     /*
      * Exercise B: find the max of "total_volumes"
      * Expected output: The date with the highest trading volume and the volume on that day in euros.
      */
      
-    struct date_yyyymmdd_t date;
-     
-    double highest_volume = data->price[0];
-    uint16_t day = 0;
+    /* from the first day with data */
+    size_t day = next_valid(data->valid, 0, data->num_entries);
+    double highest_volume = data->price[day];
     
-    for (uint16_t i = 0; i < data->num_entries - 1; i++) {
+    /* all but the last day */
+    for (size_t i = next_valid(data->valid, day, data->num_entries); i + 1 < data->num_entries;
+         i = next_valid(data->valid, i + 1, data->num_entries)) {
         if (data->volume[i] > highest_volume) {
             day = i;
             highest_volume = data->volume[i];
@@ -132,17 +230,16 @@ int8_t exercise_b (struct data_t *data) {
     }
 
 #if DEBUG
-    printf("day: %d\tvolume: %.4f\n", day, highest_volume);
+    printf("day: %zu\tvolume: %.4f\n", day, highest_volume);
 #endif
 
-    add_days_to_date(&(data->date_begin), &date, day);
-    printf("Highest trading volume %f on %04d-%02d-%02d\n",
-           highest_volume, date.year, date.month, date.day);
+    results->highest_volume = highest_volume;
+    results->volume_day = day;
 
     return 0;
 }
 
-int8_t exercise_c (struct data_t *data, uint32_t principal) {
+int8_t exercise_c (struct data_t *data, struct results_t *results, uint32_t principal) {
     /* 
      * Exercise C: find the biggest price difference where date_price_min precedes date_price_max
      * Expected output: A pair of days: The day to buy and the day to sell.
@@ -150,8 +247,10 @@ int8_t exercise_c (struct data_t *data, uint32_t principal) {
      *
      */
      
-    uint16_t range = data->num_entries;
+    size_t range = data->num_entries;
     double *price = data->price;
+    /* from the first day with data */
+    size_t first = next_valid(data->valid, 0, range);
 
     struct pair_t trade;
     trade.sell_price = 0;
@@ -160,23 +259,20 @@ int8_t exercise_c (struct data_t *data, uint32_t principal) {
     trade.buy_date = 0;
     
     struct pair_t pair[2];
-    pair[0].buy_date = 0;
-    pair[0].buy_price = price[0];
+    pair[0].buy_date = first;
+    pair[0].buy_price = price[first];
     pair[0].sell_price = 0;
     pair[0].sell_date = 0;
     uint8_t num_pairs = 1;
     
-    double price_min = price[0];
-    double price_max = price[0];    
+    double price_min = price[first];
+    double price_max = price[first];    
 
     pair[1].buy_date = 0;
     pair[1].buy_price = 0;  
     pair[1].sell_date = 0;
     pair[1].sell_price = 0;
     
-    struct date_yyyymmdd_t date_buy;
-    struct date_yyyymmdd_t date_sell;
-    
 #if DEBUG
     uint8_t something_was_done = 0;
 #endif
@@ -188,20 +284,20 @@ int8_t exercise_c (struct data_t *data, uint32_t principal) {
      * If new global max is found after there are 2 pairs, eliminate 1st pair, move 2nd to 1st.
      */
 
-    for (uint16_t i = 0; i < range; i++) {
+    for (size_t i = first; i < range; i = next_valid(data->valid, i + 1, range)) {
 #if DEBUG       
-        printf ("\n\n-----Day: %d\n\n", i);
+        printf ("\n\n-----Day: %zu\n\n", i);
         something_was_done = 0;
 #endif      
         if (price[i] > price_max) {
             price_max = price[i];
 #if DEBUG           
-            printf("New global maximum at %.4f on %d\n", price_max, i);
+            printf("New global maximum at %.4f on %zu\n", price_max, i);
 #endif          
             /* if a new max is found then the minimum-maximum pair wins */
             if (num_pairs > 1) {
 #if DEBUG               
-                printf("\nRemoving pair[0]\tbuy date: %d\tsell date: %d\tdifference: %.2f\nreturn on investment: %.2f (%.2f pct)\n\n",
+                printf("\nRemoving pair[0]\tbuy date: %zu\tsell date: %zu\tdifference: %.2f\nreturn on investment: %.2f (%.2f pct)\n\n",
                            pair[0].buy_date,
                            pair[0].sell_date,
                            (pair[0].buy_price - pair[0].sell_price),
@@ -220,7 +316,7 @@ int8_t exercise_c (struct data_t *data, uint32_t principal) {
             pair[0].sell_price = price[i];
             
 #if DEBUG           
-            printf("Adjusting winning pair's sell price to %.4f (%d)\n",
+            printf("Adjusting winning pair's sell price to %.4f (%zu)\n",
                    pair[0].sell_price, pair[0].sell_date);          
             something_was_done = 1;
 #endif                 
@@ -230,7 +326,7 @@ int8_t exercise_c (struct data_t *data, uint32_t principal) {
             price_min = price[i];
             
 #if DEBUG           
-            printf("New global minimum at %.4f on %d\n", price_min, i);
+            printf("New global minimum at %.4f on %zu\n", price_min, i);
             something_was_done = 1;
 #endif                  
 
@@ -246,7 +342,7 @@ int8_t exercise_c (struct data_t *data, uint32_t principal) {
                 pair[1].sell_price = 0;
             }
 #if DEBUG           
-            printf("Adjusting latest pair's buy price to %.4f (%d)\n",
+            printf("Adjusting latest pair's buy price to %.4f (%zu)\n",
                            pair[num_pairs - 1].buy_price, pair[num_pairs - 1].buy_date);
 #endif
         }
@@ -256,7 +352,7 @@ int8_t exercise_c (struct data_t *data, uint32_t principal) {
                     pair[1].sell_price = price[i];
                     pair[1].sell_date = i;
 #if DEBUG                   
-                    printf("Adjusting pair[1] sell price to %.4f (%d)\n",
+                    printf("Adjusting pair[1] sell price to %.4f (%zu)\n",
                                pair[1].sell_price, pair[1].sell_date);                  
                     something_was_done = 1;
 #endif
@@ -265,7 +361,7 @@ int8_t exercise_c (struct data_t *data, uint32_t principal) {
                 /* remove old pair if new is better */
                 if (((pair[1].sell_price - pair[1].buy_price) - (pair[0].sell_price - pair[0].buy_price)) > 0) {
 #if DEBUG                   
-                    printf("\nRemoving pair[0]\tbuy date: %d\tsell date: %d\tdifference: %.2f\nreturn on investment: %.2f (%.2f pct)\n\n",
+                    printf("\nRemoving pair[0]\tbuy date: %zu\tsell date: %zu\tdifference: %.2f\nreturn on investment: %.2f (%.2f pct)\n\n",
                            pair[0].buy_date,
                            pair[0].sell_date,
                            (pair[0].buy_price - pair[0].sell_price),
@@ -284,7 +380,7 @@ int8_t exercise_c (struct data_t *data, uint32_t principal) {
 #if DEBUG
         if (something_was_done == 1) {
             for (uint8_t p = 0; p < num_pairs; p++) {
-                printf("\npair %d\tbuy date: %d\tsell date: %d\tdifference: %.2f\nreturn on investment: %.2f (%.2f pct)\n\n",
+                printf("\npair %d\tbuy date: %zu\tsell date: %zu\tdifference: %.2f\nreturn on investment: %.2f (%.2f pct)\n\n",
                     p, pair[p].buy_date, pair[p].sell_date,
                     (pair[p].buy_price - pair[p].sell_price),
                     ((principal / pair[p].buy_price) * (pair[p].sell_price - pair[p].buy_price)),
@@ -299,363 +395,1870 @@ int8_t exercise_c (struct data_t *data, uint32_t principal) {
     trade.buy_price = pair[0].buy_price;
     trade.sell_date = pair[0].sell_date;
     trade.buy_date = pair[0].buy_date;
-/* TODO: convert day index to yyyy-mm-dd */
-    if (trade.sell_price > 0) {
 #if DEBUG
-        printf("buy date: %d\tsell date: %d\tdifference: %.2f\nreturn on investment: %.2f pct\n\n",
+    if (trade.sell_price > 0) {
+        printf("buy date: %zu\tsell date: %zu\tdifference: %.2f\nreturn on investment: %.2f pct\n\n",
                trade.buy_date, trade.sell_date,
                (trade.sell_price - trade.buy_price),
                (((principal / trade.buy_price) * (trade.sell_price - trade.buy_price)) / principal) * 100);
+    }
+#else
+    (void) principal;
 #endif
-        
-        add_days_to_date(&(data->date_begin), &date_buy, trade.buy_date);
-        add_days_to_date(&(data->date_begin), &date_sell, trade.sell_date);
+    results->trade = trade;
+    
+    return 0;
+}
+
+/* the exercises' results as they're shown for a query */
+static void print_results (struct data_t *data, struct results_t *results, uint32_t principal) {
+    struct pair_t *trade = &results->trade;
+    struct date_yyyymmdd_t date_start;
+    struct date_yyyymmdd_t date_stop;
+    
+    printf("\nExercise A: ");
+    add_days_to_date(&(data->date_begin), &date_start, results->trend_start);
+    add_days_to_date(&(data->date_begin), &date_stop, results->trend_stop);
+    printf("Longest bear trend of %zu days between %04d-%02d-%02d and %04d-%02d-%02d\n",
+           results->trend_days, date_start.year, date_start.month, date_start.day, date_stop.year, date_stop.month, date_stop.day);
+    printf("\n");
+    
+    printf("Exercise B: ");
+    add_days_to_date(&(data->date_begin), &date_start, results->volume_day);
+    printf("Highest trading volume %f on %04d-%02d-%02d\n",
+           results->highest_volume, date_start.year, date_start.month, date_start.day);
+    printf("\n");
+    
+    printf("Exercise C: ");
+    if (trade->sell_price > 0) {
+        add_days_to_date(&(data->date_begin), &date_start, trade->buy_date);
+        add_days_to_date(&(data->date_begin), &date_stop, trade->sell_date);
         
         printf("Dates for the best deal at %.2f pct ROI (diff: %.2f)\n            Buy on: %04d-%02d-%02d\tSell on: %04d-%02d-%02d\n\n",
-               (((principal / trade.buy_price) * (trade.sell_price - trade.buy_price)) / principal) * 100,
-               (trade.sell_price - trade.buy_price),
-               date_buy.year, date_buy.month, date_buy.day,
-               date_sell.year, date_sell.month, date_sell.day);
+               (((principal / trade->buy_price) * (trade->sell_price - trade->buy_price)) / principal) * 100,
+               (trade->sell_price - trade->buy_price),
+               date_start.year, date_start.month, date_start.day,
+               date_stop.year, date_stop.month, date_stop.day);
     } else {
         printf("No opportunity for hodling but consider shorting if you're not afraid of margin calls!\n");
     }
-     
-    return 0;
+    printf("\n");
 }
 
-/* get data from json into arrays by matching hardcoded object identifiers */
-/* for non daily data, finds the closest timestamp to midnight */
-/* could increase resolution by getting data with finer granularity for the intended range with multiple <=90 day queries */
-int process_json_data (struct data_t *data, json_value *value, uint8_t not_daily_data) {
-    json_object_entry object;
-    json_value *array;
+/* one tab separated line per batch query:
+   coin, from, to, status (ok, failed or nodata) and for ok
+   down trend days, from, to, highest volume, its date, best deal's ROI pct, buy and sell dates (- if there's no deal) */
+static void print_record (FILE *out, const char *name, struct data_t *data, struct results_t *results, int8_t result) {
+    struct pair_t *trade = &results->trade;
+    struct date_yyyymmdd_t date_start;
+    struct date_yyyymmdd_t date_stop;
     
-    uint32_t length = value->u.object.length;
-    int64_t *timestamp = data->timestamp;
-    double *saved_data;
+    fprintf(out, "%s\t%04d-%02d-%02d\t%04d-%02d-%02d\t%s", name,
+           data->date_begin.year, data->date_begin.month, data->date_begin.day,
+           data->date_end.year, data->date_end.month, data->date_end.day,
+           (result == 0) ? "ok" : ((result < 0) ? "nodata" : "failed"));
+    if (result != 0) {
+        fprintf(out, "\n");
+        return;
+    }
     
-    uint32_t array_length = 0;
-    uint32_t day;
+    add_days_to_date(&(data->date_begin), &date_start, results->trend_start);
+    add_days_to_date(&(data->date_begin), &date_stop, results->trend_stop);
+    fprintf(out, "\t%zu\t%04d-%02d-%02d\t%04d-%02d-%02d", results->trend_days,
+           date_start.year, date_start.month, date_start.day, date_stop.year, date_stop.month, date_stop.day);
     
-    /* when comparing timestamps to midnight */
-    uint32_t dist_prev;
-    uint32_t dist_cur;
-    int64_t timestamp_cur;
-    int64_t timestamp_prev;
-    int64_t timestamp_midnight;
+    add_days_to_date(&(data->date_begin), &date_start, results->volume_day);
+    fprintf(out, "\t%f\t%04d-%02d-%02d", results->highest_volume, date_start.year, date_start.month, date_start.day);
     
-    /*
-     * 0: Off
-     * 1: use the last data of the previous day if its timestamp is closer to midnight
-     */
-    uint8_t autism = 0;
+    if (trade->sell_price > 0) {
+        add_days_to_date(&(data->date_begin), &date_start, trade->buy_date);
+        add_days_to_date(&(data->date_begin), &date_stop, trade->sell_date);
+        fprintf(out, "\t%.2f\t%04d-%02d-%02d\t%04d-%02d-%02d\n", ((trade->sell_price - trade->buy_price) / trade->buy_price) * 100,
+               date_start.year, date_start.month, date_start.day, date_stop.year, date_stop.month, date_stop.day);
+    } else {
+        fprintf(out, "\t-\t-\t-\n");
+    }
+}
+
+/* the series of a market_chart response */
+#define SERIES_PRICE 0
+#define SERIES_MARKET_CAP 1
+#define SERIES_VOLUME 2
+#define SERIES_COUNT 3
+
+/* ranges up to 90 days come in hourly resolution, longer ones are fetched in windows of at most this */
+#define WINDOW_SECONDS (60*60*24*90)
+
+/* state for decoding the json events straight into raw series */
+struct json_decoder_t {
+    struct series_t series[SERIES_COUNT];
+    struct series_t *saved_series;  /* series of the current object entry, NULL if not wanted */
+    uint8_t depth;
     
-    for (uint8_t i = 0; i < length; i++) {
-        object = value->u.object.values[i];
-        array_length = object.value->u.array.length;
-#if DEBUG       
-        printf("Object %d: %s\n", i, object.name);
-        printf("array length: %d\n", array_length);
-#endif
-        if (strcmp(value->u.object.values[i].name, "prices") == 0) {
-            saved_data = data->price;
-        } else if (strcmp(value->u.object.values[i].name, "market_caps") == 0) {
-            saved_data = data->market_cap;
-        } else if (strcmp(value->u.object.values[i].name, "total_volumes") == 0) {
-            saved_data = data->volume;
-        } else {
-#if DEBUG           
-            printf("all required objects parsed!");
-#endif
-            return 1;
-        }
+    /* the response is decoded as it comes in */
+    json_sax_stream *stream;
+    uint8_t received;
+    uint8_t failed;
+    char error[json_error_max];
+    
+    /* the [timestamp, value] pair being decoded */
+    uint8_t pair_fields;
+    int64_t pair_timestamp;
+    double pair_value;
+};
 
-        /* if hourly or 5 minute data, find the entry whose timestamp is closest to midnight */
-        if (not_daily_data) {
-#if DEBUG           
-            printf("Not daily data...\n");
-#endif          
-            day = 0;
-            array = object.value->u.array.values[0];
-            timestamp[day] = (int64_t) array->u.array.values[0]->u.integer / 1000;;
-            saved_data[day] = (double) array->u.array.values[1]->u.dbl;
-            timestamp_midnight = get_timestamp(&(data->date_begin)) + day * (60*60*24);
-#if DEBUG           
-            printf("day: %03d: %15lld: timestamp[%d]: %15lld (%15lld)\n",
-                   day, timestamp_midnight-timestamp[day], 0, timestamp[day], timestamp_midnight);
-#endif
-            for (uint32_t j = 1; j < array_length; j++) {
-                if (day == (data->num_entries - 1)) {
-#if DEBUG                   
-                    printf("got all data. break\n");
-#endif                  
-                    break;
-                }
-                
-                array = object.value->u.array.values[j];
-                timestamp_cur = (int64_t) array->u.array.values[0]->u.integer / 1000;
-                timestamp_midnight = get_timestamp(&(data->date_begin)) + (day + 1) * (60*60*24);
-#if DEBUG               
-                printf("day: %03d: %15lld: timestamp[%d]: %15lld (%15lld)\n",
-                       day, timestamp_midnight-timestamp_cur, j, timestamp_cur, timestamp_midnight);
-#endif              
-                /* if found the first timestamp for the next day or the last in the array... */
-                if ((timestamp_cur >= timestamp_midnight) || (j == (array_length - 1))) {
-                    /* if feeling pedantic then could check the previous entry here if it's closer and use that becase
-                    *   11:59 is closer to midnight than 12:02 unless meant "closest time to midnight on the same day :D"
-                    */
-#if DEBUG
-                    printf("next day\n");
-#endif                  
-                    day++;
-                    
-                    dist_cur = timestamp_cur - timestamp_midnight;
-                    
-                    array = object.value->u.array.values[j - 1];
-                    timestamp_prev = (int64_t) array->u.array.values[0]->u.integer / 1000;
-                    dist_prev = timestamp_midnight - timestamp_prev;
-                    
-                    if ((dist_prev < dist_cur) && (autism == 1)) {
-                        timestamp[day] = timestamp_prev;
-#if DEBUG                       
-                        printf("using yesterday's timestamp %15lld\n", timestamp_prev);
-#endif                      
-                    } else {
-                        timestamp[day] = timestamp_cur;
-#if DEBUG
-                        printf("using today's timestamp %15lld\n", timestamp_cur);
-#endif
-                        array = object.value->u.array.values[j];
-                    }
-                    
-                    saved_data[day] = (double) array->u.array.values[1]->u.dbl;
-                }
-#if DEBUG                   
-                printf("timestamp: %15lld\n", timestamp[day]);
-                printf("value: %f\n", saved_data[day]);
-#endif
-            }
-                
-        } else {
-            /* daily data, trust that it's consistent and just copy 1:1 */
-            for (uint32_t j = 0; j < array_length; j++) {
-                    array = object.value->u.array.values[j]; /* the array storing timestamp & data */
-                    timestamp[j] = (int64_t) array->u.array.values[0]->u.integer / 1000;
-                    saved_data[j] = (double) array->u.array.values[1]->u.dbl;
-#if DEBUG                   
-                    printf("timestamp %03d: %15lld\n", j, timestamp[j]);
-                    printf("value %03d: %f\n", j, saved_data[j]);
-#endif                  
-                    
-            }
-        }
-    }
+static int decoder_key (const json_char *name, unsigned int name_length, void *user_data) {
+    struct json_decoder_t *decoder = user_data;
+    (void) name_length;
     
-    day = array_length - 1;
+    if (decoder->depth != 1) {
+        return 1;
+    }
 #if DEBUG
-    printf("recv: %d expected: %d\n", day, data->num_entries - 1);
-#endif  
-    if (day < (data->num_entries - 1)) {
-        printf("warning: didn't receive enough data. recv: %d expected: %d\n", day, data->num_entries - 1);
-        data->num_entries = day + 1;
+    printf("Object: %s\n", name);
+#endif
+    if (strcmp(name, "prices") == 0) {
+        decoder->saved_series = &decoder->series[SERIES_PRICE];
+    } else if (strcmp(name, "market_caps") == 0) {
+        decoder->saved_series = &decoder->series[SERIES_MARKET_CAP];
+    } else if (strcmp(name, "total_volumes") == 0) {
+        decoder->saved_series = &decoder->series[SERIES_VOLUME];
+    } else {
+        decoder->saved_series = NULL;
     }
     
-    return 0;
+    return 1;
 }
 
-int main (int argc, char *argv[]) {
-    uint32_t principal = 1000;
-    uint8_t not_daily_data = 1;
-    
-    struct data_t data;
+static int decoder_object_begin (void *user_data) {
+    ((struct json_decoder_t *) user_data)->depth++;
+    return 1;
+}
 
-    struct MemoryStruct chunk;
-    char *req;
+static int decoder_object_end (void *user_data) {
+    ((struct json_decoder_t *) user_data)->depth--;
+    return 1;
+}
 
-#if DEBUG   
-    for (uint8_t arg = 0; arg < argc; arg++) {
-        printf("%s ", argv[arg]);
+static int decoder_array_begin (void *user_data) {
+    struct json_decoder_t *decoder = user_data;
+    
+    decoder->depth++;
+    if (decoder->depth == 3) {
+        decoder->pair_fields = 0;
     }
-    printf("\n");
-#endif
     
-    if (argc >= 4) {
-        /* first argument is coin_name */
-        printf("coin: %s\n", argv[1]);
+    return 1;
+}
 
-        /* second is begin date, third is end date */
-        /* parse dates from strings */
-        if (parse_date(argv[2], &(data.date_begin)) == 0) {
-            printf("error: invalid date format\n");
-            return 1;
-        }
-        if (parse_date(argv[3], &(data.date_end)) == 0) {
-            printf("error: invalid date format\n");
-            return 1;
+static int decoder_array_end (void *user_data) {
+    struct json_decoder_t *decoder = user_data;
+    
+    if ((decoder->depth == 3) && (decoder->saved_series != NULL)) {
+        if (decoder->pair_fields < 2) {
+            fprintf(messages, "error: expected [timestamp, value] pairs\n");
+            return 0;
         }
-        
-        if (0 == is_valid_date(&data.date_begin)) {
-            printf("error: invalid begin date\n");
-            return 1;
+        if (series_append(decoder->saved_series, decoder->pair_timestamp, decoder->pair_value) == 0) {
+            return 0;
         }
-        
-        if (0 == is_valid_date(&data.date_end)) {
-            printf("error: invalid end date\n");
-            return 1;
-        }       
-        
-        /* get unix timestamps and add 1 hour to end time to make sure the last day's data is included */
-        data.begin_timestamp = get_timestamp(&(data.date_begin));
-        data.end_timestamp = get_timestamp(&(data.date_end)) + (60*60);
+    }
+    decoder->depth--;
     
-        data.num_entries = days_between(&(data.date_begin), &(data.date_end));
-        
-        printf("begin date: %s (%lld)\n", argv[2], data.begin_timestamp);
-        printf("end date: %s (%lld)\n", argv[3], data.end_timestamp);
-        printf("days: %d\n", data.num_entries);
+    return 1;
+}
 
-        data.timestamp = malloc(sizeof(int64_t) * data.num_entries);
-        if (data.timestamp == NULL) {
-            printf("error: malloc data.timestamp\n");
-            return 1;
-        }
-        data.price = malloc(sizeof(double) * data.num_entries);
-        if (data.price == NULL) {
-            printf("error: malloc data.price\n");
-            return 1;
-        }
-        data.volume = malloc(sizeof(double) * data.num_entries);
-        if (data.volume == NULL) {
-            printf("error: malloc data.volume\n");
-            return 1;
-        }
-        data.market_cap = malloc(sizeof(double) * data.num_entries);
-        if (data.market_cap == NULL) {
-            printf("error: malloc data.market_cap\n");
-            return 1;
+static int decoder_integer (json_int_t integer, void *user_data) {
+    struct json_decoder_t *decoder = user_data;
+    
+    if (decoder->depth == 3) {
+        if (decoder->pair_fields == 0) {
+            decoder->pair_timestamp = (int64_t) integer / 1000;
+        } else if (decoder->pair_fields == 1) {
+            decoder->pair_value = (double) integer;
         }
+        decoder->pair_fields++;
+    }
     
-        /* optional fourth argument is the amount of money to use for exercise C. defaults to something */
-        if (argc == 5) {
-            principal = atoi(argv[4]);
+    return 1;
+}
+
+static int decoder_dbl (double dbl, void *user_data) {
+    struct json_decoder_t *decoder = user_data;
+    
+    if (decoder->depth == 3) {
+        if (decoder->pair_fields == 0) {
+            decoder->pair_timestamp = (int64_t) dbl / 1000;
+        } else if (decoder->pair_fields == 1) {
+            decoder->pair_value = dbl;
         }
-    } else {
-        printf("error: invalid number of arguments\nusage: %s [coin_name] [from] [to]\ne.g.: %s monero 2021-09-16 2021-11-01\n",
-                argv[0], argv[0]);
+        decoder->pair_fields++;
+    }
+    
+    return 1;
+}
+
+/* runs of [timestamp, value] pairs of a series, decoded by the parser into columns */
+static int decoder_series (const json_int_t *timestamps, const double *values, size_t count, void *user_data) {
+    struct json_decoder_t *decoder = user_data;
+    size_t i;
+    
+    if ((decoder->depth != 2) || (decoder->saved_series == NULL)) {
         return 1;
     }
+    for (i = 0; i < count; i++) {
+        if (series_append(decoder->saved_series, (int64_t) timestamps[i] / 1000, values[i]) == 0) {
+            return 0;
+        }
+    }
     
-    /* Get json file */
-    req = malloc(sizeof(char) * (104 + strlen(argv[1])));
-    if (req == NULL) {
-        printf("error: malloc req\n");
-        return -1;
-    }    
+    return 1;
+}
+
+/* called by WriteMemoryCallback as the response comes in, decodes as much of it as is complete */
+static size_t decoder_feed (const char *json, size_t size, void *user_data) {
+    struct json_decoder_t *decoder = user_data;
+    size_t used;
     
-    sprintf(req, "https://api.coingecko.com/api/v3/coins/%s/market_chart/range?vs_currency=eur&from=%" PRIu64 "&to=%" PRIu64, 
-                            argv[1], data.begin_timestamp, data.end_timestamp);
+    decoder->received = 1;
+    if (!json_sax_feed(decoder->stream, (const json_char *) json, size, &used, decoder->error)) {
+        decoder->failed = 1;
+        return (size_t) -1;
+    }
+#if DEBUG
+    printf("decoded %zu of %zu buffered bytes\n", used, size);
+#endif
+    
+    return used;
+}
 
-    printf("req: %s\n", req);
+/* seconds between samples: daily, hourly or 5 min, told from the spacing of the first timestamps */
+static uint32_t series_resolution (const struct series_t *series) {
+    /* a single entry is a single day */
+    int64_t spacing = (60*60*24);
     
-    chunk.memory = malloc(1);
-    chunk.size = 0;
-    request(req, &chunk);
+    if (series->length >= 2) {
+        spacing = series->timestamp[1] - series->timestamp[0];
+    }
+#if DEBUG
+    printf("timestamp spacing: %" PRId64 "\n", spacing);
+#endif
+    if (spacing >= (60*60*12)) {
+        return (60*60*24);
+    } else if (spacing >= (60*30)) {
+        return (60*60);
+    }
+    return (60*5);
+}
+
+/* tell the data resolution from the spacing of the first timestamps */
+static uint8_t detect_resolution (const struct series_t *series, const char **resolution) {
+    uint32_t spacing = series_resolution(series);
     
-    if (chunk.size < 100) {
-        printf("error: invalid response or no data\n");
+    if (spacing == (60*60*24)) {
+        *resolution = "daily";
         return 0;
+    } else if (spacing == (60*60)) {
+        *resolution = "hourly";
+    } else {
+        *resolution = "5 min";
     }
     
-#if DEBUG   
-    printf("response size: %d\n", chunk.size);
+    return 1;
+}
+
+/* first index from "from" on whose timestamp is at or after t, length if there's none.
+   gallops ahead first, as the next day is usually only a day's worth of samples away, then searches in between */
+static size_t find_timestamp (const int64_t *timestamps, size_t from, size_t length, int64_t t) {
+    size_t low = from;
+    size_t high = from;
+    size_t step = 1;
+    size_t mid;
     
-    for (uint32_t i = 0; i < chunk.size; i++) {
-        printf("%c", chunk.memory[i]);
+    while ((high < length) && (timestamps[high] < t)) {
+        low = high + 1;
+        high += step;
+        step *= 2;
     }
-#endif  
-
-    /* Prints and parses the json file */
-    uint32_t file_size;
-    char *file_contents;
-    json_char *json;
-    json_value *value;
+    if (high > length) {
+        high = length;
+    }
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        if (timestamps[mid] < t) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    
+    return low;
+}
 
-    file_size = chunk.size;
-    file_contents = &chunk.memory[0];
+/* fills a column of data with one value per day, the first one at or after the day's midnight,
+   found from the timestamps so that a day that's missing doesn't shift the ones after it.
+   a day without any is cleared in the validity bitmap. returns the number of days filled */
+static size_t bucket_series (struct data_t *data, double *saved_data, const struct series_t *series) {
+    int64_t *timestamp = data->timestamp;
+    int64_t timestamp_begin = get_timestamp(&(data->date_begin));
+    int64_t timestamp_midnight;
+    size_t next = 0;                /* after the pair used for the latest day that had one */
+    size_t day;
+    size_t i;
+    
+    /*
+     * 0: Off
+     * 1: use the last data of the previous day if its timestamp is closer to midnight
+     */
+    uint8_t autism = 0;
+    
+    if ((series->length == 0) || (data->num_entries == 0)) {
+        return 0;
+    }
+    
+    for (day = 0; day < data->num_entries; day++) {
+        timestamp_midnight = timestamp_begin + (int64_t) day * (60*60*24);
+        i = find_timestamp(series->timestamp, next, series->length, timestamp_midnight);
+        
+        if (i == series->length) {
+            /* the last in the series counts as the next day, unless it's been used already */
+            if ((day > 0) && (next < series->length)) {
+                timestamp[day] = series->timestamp[series->length - 1];
+                saved_data[day] = series->value[series->length - 1];
+                day++;
+            }
+            break;
+        }
+        
+        if (series->timestamp[i] >= timestamp_midnight + (60*60*24)) {
+            /* nothing on this day */
+            timestamp[day] = timestamp_midnight;
+            saved_data[day] = 0;
+            data->valid[day / 64] &= ~((uint64_t) 1 << (day % 64));
+            continue;
+        }
+        
+        /* if feeling pedantic then could check the previous entry here if it's closer and use that becase
+        *   11:59 is closer to midnight than 12:02 unless meant "closest time to midnight on the same day :D"
+        */
+        if ((autism == 1) && (i > next) &&
+            (timestamp_midnight - series->timestamp[i - 1] < series->timestamp[i] - timestamp_midnight)) {
+            i--;
+        }
+        timestamp[day] = series->timestamp[i];
+        saved_data[day] = series->value[i];
+        next = i + 1;
 #if DEBUG
-    printf("%s\n", file_contents);
-    printf("--------------------------------\n\n");
+        printf("day: %03zu: timestamp[%zu]: %15" PRId64 " (%15" PRId64 ") value: %f\n",
+               day, i, timestamp[day], timestamp_midnight, saved_data[day]);
 #endif
+    }
+    
+    return day;
+}
 
-    json = (json_char *)file_contents;
-
-    value = json_parse(json, file_size);
-
-    if (value == NULL) {
-            fprintf(stderr, "Unable to parse data\n");
-            free(file_contents);
-            exit(1);
-    }
-    
-    /* Calculate whether not_daily_data based on something
-        a) response size
-            ~28000 / 2 = 14 000 bytes per day for 2 days of 5 min data
-            ~2400 bytes per day for hourly data
-            ~100 bytes for daily data
-        b) array size: >280 for 2 days at 5 min, >20 / day for hourly, <2 / day for daily
-        c) checking if days >= 90 else if = <90 else if ((day_begin = yesterday) && (day_end = today))
-    */  
-    if ((file_size / data.num_entries) < 200) {
-        /* daily data */
-        not_daily_data = 0;
-        printf("data is in daily format\n");
-    } else if ((file_size / data.num_entries) < 3000) {
-        /* hourly data */
-        not_daily_data = 1;
-        printf("data is in hourly format\n");
-    } else {
-        /* 5 minute data */
-        not_daily_data = 1;
-        printf("data is in 5 min format\n");
+struct coin_t;
+struct resident_t;
+
+/* one request for a coin's range, at most WINDOW_SECONDS long */
+struct window_t {
+    struct coin_t *coin;
+    char *req;
+    char *key;                  /* names the window's response when recording or replaying */
+    struct json_decoder_t decoder;
+    struct MemoryStruct chunk;
+    int8_t result;
+};
+
+/* one coin being fetched, decoded and analyzed */
+struct coin_t {
+    char *name;
+    struct window_t *windows;
+    uint32_t num_windows;
+    uint32_t windows_left;
+    struct series_t series[SERIES_COUNT];   /* the windows merged, or pointing into the cache */
+    char *cache_path;           /* where the coin's series are cached, NULL if they aren't */
+    struct cache_t cache;       /* mapped when it has the range, or the start of it */
+    int64_t fetch_begin;        /* the range is fetched from here, where the cache ends if it has the start */
+    struct data_t data;
+    uint32_t principal;
+    int32_t priority;           /* coins listed first are fetched first when the rate is limited */
+    uint8_t show_name;          /* more than one coin, so tell the results apart */
+    const char *bar_size;       /* also print bars of this size, e.g. 1h, NULL for none */
+    uint8_t batch;              /* results as a record instead of for reading */
+    FILE *out;                  /* where the record goes */
+    /* a superset of overlapping queries of the coin is fetched once and sliced for each of them */
+    struct coin_t *members;     /* the queries, if this is a superset */
+    struct coin_t *next_member;
+    uint8_t in_superset;
+    struct resident_t *resident;    /* kept in memory by the server, to be updated with what's fetched */
+    int8_t result;
+};
+
+static void window_done (struct MemoryStruct *chunk, int failed, void *done_data);
+
+/* start downloading the json, it's decoded as it comes in straight into the series by matching hardcoded object identifiers, no json_value tree is built */
+/* returns 0 on success, 1 if the request couldn't be started */
+int process_json_data (struct fetch_t *fetch, struct window_t *window) {
+    struct json_decoder_t *decoder = &window->decoder;
+    json_settings settings;
+    json_sax_handler handler;
+    
+    memset(decoder, 0, sizeof(*decoder));
+    memset(&settings, 0, sizeof(settings));
+    memset(&handler, 0, sizeof(handler));
+    
+    handler.object_begin = decoder_object_begin;
+    handler.object_end = decoder_object_end;
+    handler.array_begin = decoder_array_begin;
+    handler.array_end = decoder_array_end;
+    handler.key = decoder_key;
+    handler.integer = decoder_integer;
+    handler.dbl = decoder_dbl;
+    handler.series = decoder_series;
+    handler.user_data = decoder;
+    
+    decoder->stream = json_sax_stream_new(&settings, &handler);
+    if (decoder->stream == NULL) {
+        fprintf(messages, "error: json_sax_stream_new\n");
+        return 1;
     }
-#if DEBUG   
-    printf("size per day: %u not_daily_data: %d\n", (uint32_t) (file_size / data.num_entries), not_daily_data);
-#endif
+    
+    /* only the undecoded tail is kept, so the buffer doesn't need to fit the whole response */
+    if (memory_acquire(&window->chunk, MEMORY_MIN_CAPACITY) == 0) {
+        json_sax_stream_free(decoder->stream);
+        decoder->stream = NULL;
+        return 1;
+    }
+    window->chunk.consume = decoder_feed;
+    window->chunk.consume_data = decoder;
+    
+    if (fetch_add(fetch, window->req, window->key, &window->chunk, window->coin->priority, window_done, window) != 0) {
+        json_sax_stream_free(decoder->stream);
+        decoder->stream = NULL;
+        memory_release(&window->chunk);
+        return 1;
+    }
+    
+    return 0;
+}
 
-    /* load entries from json into arrays */
-    process_json_data(&data, value, not_daily_data);
+/* returns 0 on success, 1 if the response couldn't be decoded and -1 if it held no data */
+static int8_t finish_json_data (struct window_t *window, int failed) {
+    struct json_decoder_t *decoder = &window->decoder;
+    int8_t result = 0;
     
-#if DEBUG   
-    printf("data processed\n");
-    printf("data:\n");
-    for (uint16_t i = 0; i < data.num_entries; i++) {
-        printf("%03d: %15lld\t%.4f\t%f\t%f\n", i, data.timestamp[i], data.price[i], data.volume[i], data.market_cap[i]);
+    /* an error status, a broken connection or running out of retries leaves an empty or partial body, which isn't "no data".
+       otherwise what's left in the buffer has to complete the document */
+    if (failed) {
+        result = 1;
+    } else if (!decoder->received) {
+        result = -1;
+    } else if (decoder->failed || !json_sax_finish(decoder->stream, (const json_char *) window->chunk.memory, window->chunk.size, decoder->error)) {
+        fprintf(stderr, "Unable to parse data: %s\n", decoder->error);
+        result = 1;
+    } else if (decoder->series[SERIES_PRICE].length == 0) {
+        result = -1;
     }
     
-    printf("\n");
-#endif
+    json_sax_stream_free(decoder->stream);
+    decoder->stream = NULL;
+    memory_release(&window->chunk);
+    
+    return result;
+}
 
-    /* exercises */
-    printf("\nExercise A: ");
-    exercise_a(&data);
-    printf("\n");
+/* how far the cache can be said to have the range: up to its end, unless that's past the last sample plus its spacing,
+   e.g. for a range ending today. the rest is fetched again the next time */
+static int64_t cached_until (const struct series_t *price, uint32_t resolution, int64_t end) {
+    if ((price->length > 0) && (price->timestamp[price->length - 1] + resolution < end)) {
+        return price->timestamp[price->length - 1] + resolution;
+    }
+    return end;
+}
+
+/* saves the fetched columns merged with the ones in the cache file, which has a range that overlaps or adjoins theirs,
+   the fetched samples winning where both have one. returns 1 on success */
+static int8_t cache_store_merged (struct coin_t *coin, const struct cache_t *cached, uint32_t resolution, int64_t until,
+                                  double *volume, double *market_cap) {
+    struct series_t *price = &coin->series[SERIES_PRICE];
+    const double *columns[SERIES_COUNT];
+    struct series_t merged[SERIES_COUNT];
+    struct series_t parts[2];
+    struct cache_header_t header;
+    uint8_t kind;
+    int8_t ok = 1;
     
-    printf("Exercise B: ");
-    exercise_b(&data);
-    printf("\n");
+    columns[SERIES_PRICE] = price->value;
+    columns[SERIES_VOLUME] = volume;
+    columns[SERIES_MARKET_CAP] = market_cap;
+    memset(merged, 0, sizeof(merged));
     
-    printf("Exercise C: ");
-    exercise_c (&data, principal);
-    printf("\n");
+    /* the cache's columns share its timestamps as the fetched ones share the price's, so they all merge the same way */
+    for (kind = 0; (kind < SERIES_COUNT) && ok; kind++) {
+        parts[0].timestamp = price->timestamp;
+        parts[0].value = (double *) columns[kind];
+        parts[0].length = price->length;
+        parts[0].capacity = 0;
+        parts[1].timestamp = (int64_t *) cached->timestamp;
+        parts[1].value = (double *) ((kind == SERIES_PRICE) ? cached->price : (kind == SERIES_VOLUME) ? cached->volume : cached->market_cap);
+        parts[1].length = cached->header->count;
+        parts[1].capacity = 0;
+        ok = series_merge(&merged[kind], parts, 2);
+    }
     
-    json_value_free(value);
-    free(file_contents);
+    if (ok) {
+        memset(&header, 0, sizeof(header));
+        header.resolution = resolution;
+        header.count = merged[SERIES_PRICE].length;
+        header.range_begin = (coin->data.begin_timestamp < cached->header->range_begin) ? coin->data.begin_timestamp : cached->header->range_begin;
+        header.range_end = (until > cached->header->range_end) ? until : cached->header->range_end;
+        
+        ok = cache_save(coin->cache_path, &header, merged[SERIES_PRICE].timestamp, merged[SERIES_PRICE].value,
+                        merged[SERIES_VOLUME].value, merged[SERIES_MARKET_CAP].value);
+    }
     
-    free(data.timestamp);
-    free(data.price);
-    free(data.volume);
-    free(data.market_cap);
-    free(req);
+    for (kind = 0; kind < SERIES_COUNT; kind++) {
+        series_free(&merged[kind]);
+    }
     
-    return 0;
+    return ok;
+}
+
+/* saves the merged series to the coin's cache, with volume and market cap matched to the price timestamps.
+   when only the tail of the range was fetched it's appended to what's cached. a cache file that wasn't used for the
+   query isn't replaced by one with less in it: it's merged with what was fetched when their ranges meet and they're
+   in the same resolution, otherwise it's kept as it is. returns 1 on success */
+static int8_t cache_store (struct coin_t *coin) {
+    struct series_t *price = &coin->series[SERIES_PRICE];
+    uint32_t resolution = series_resolution(price);
+    int64_t until = cached_until(price, resolution, coin->data.end_timestamp);
+    int64_t begin = coin->data.begin_timestamp;
+    struct cache_header_t header;
+    struct cache_t cached;
+    double *volume;
+    double *market_cap;
+    int8_t ok;
+    
+    /* a sample or none can't tell the resolution of a refresh, it's taken to be the cache's */
+    if ((coin->cache.header != NULL) && (price->length < 2)) {
+        resolution = coin->cache.header->resolution;
+        until = cached_until(price, resolution, coin->data.end_timestamp);
+    }
+    
+    volume = malloc(sizeof(double) * (price->length ? price->length : 1));
+    market_cap = malloc(sizeof(double) * (price->length ? price->length : 1));
+    if ((volume == NULL) || (market_cap == NULL)) {
+        fprintf(messages, "error: malloc cache columns\n");
+        free(volume);
+        free(market_cap);
+        return 0;
+    }
+    series_align(&coin->series[SERIES_VOLUME], price->timestamp, price->length, volume);
+    series_align(&coin->series[SERIES_MARKET_CAP], price->timestamp, price->length, market_cap);
+    
+    if (coin->cache.header != NULL) {
+        ok = cache_append(&coin->cache, coin->cache_path, until, resolution, price->timestamp, price->value, volume, market_cap, price->length);
+    } else if ((cache_open(&cached, coin->cache_path) != 0) &&
+               ((cached.header->range_begin < begin) || (cached.header->range_end > until))) {
+        if ((cached.header->resolution == resolution) && (cached.header->range_begin <= until) && (cached.header->range_end >= begin)) {
+            ok = cache_store_merged(coin, &cached, resolution, until, volume, market_cap);
+        } else {
+            fprintf(messages, "warning: not caching %s, it would replace a cached range it doesn't cover\n", coin->name);
+            ok = 1;
+        }
+        cache_close(&cached);
+    } else {
+        cache_close(&cached);
+        memset(&header, 0, sizeof(header));
+        header.resolution = resolution;
+        header.count = price->length;
+        header.range_begin = coin->data.begin_timestamp;
+        header.range_end = until;
+        
+        ok = cache_save(coin->cache_path, &header, price->timestamp, price->value, volume, market_cap);
+    }
+    
+    free(volume);
+    free(market_cap);
+    
+    return ok;
+}
+
+/* points the coin's series at the cached columns for its range. returns 1 if there's any data in it */
+static int8_t cache_view (struct coin_t *coin) {
+    const double *columns[SERIES_COUNT];
+    size_t first;
+    size_t count;
+    uint8_t kind;
+    
+    cache_slice(&coin->cache, coin->data.begin_timestamp, coin->data.end_timestamp, &first, &count);
+    if (count == 0) {
+        return 0;
+    }
+    
+    columns[SERIES_PRICE] = coin->cache.price;
+    columns[SERIES_MARKET_CAP] = coin->cache.market_cap;
+    columns[SERIES_VOLUME] = coin->cache.volume;
+    /* views, capacity 0 as they aren't owned */
+    for (kind = 0; kind < SERIES_COUNT; kind++) {
+        series_free(&coin->series[kind]);
+        coin->series[kind].timestamp = (int64_t *) &coin->cache.timestamp[first];
+        coin->series[kind].value = (double *) &columns[kind][first];
+        coin->series[kind].length = count;
+        coin->series[kind].capacity = 0;
+    }
+    
+    return 1;
+}
+
+/* the resolution the API sends the coin's range in: ranges up to a day come in 5 minutes, windows up to 90 days in hourly */
+static uint32_t query_resolution (const struct data_t *data) {
+    return ((data->end_timestamp - data->begin_timestamp) <= (60*60*24)) ? (60*5) : (60*60);
+}
+
+/* points the coin's series at its cached columns when the cache has the range in the resolution the API would send.
+   returns 1 if it does. when it has only the start of the range, it's kept open and fetch_begin moved to where it ends */
+static int8_t cache_load (struct coin_t *coin) {
+    int64_t begin = coin->data.begin_timestamp;
+    int64_t end = coin->data.end_timestamp;
+    uint32_t resolution = query_resolution(&coin->data);
+    
+    if (cache_open(&coin->cache, coin->cache_path) == 0) {
+        return 0;
+    }
+    if ((cache_covers(&coin->cache, begin, end, resolution) != 0) && (cache_view(coin) != 0)) {
+        return 1;
+    }
+    if (cache_covers_start(&coin->cache, begin, resolution) != 0) {
+        coin->fetch_begin = coin->cache.header->range_end;
+        return 0;
+    }
+    cache_close(&coin->cache);
+    
+    return 0;
+}
+
+/* merges the windows into the coin's series and caches them. returns 0 on success, 1 on failure and -1 if there was no data */
+static int8_t merge_windows (struct coin_t *coin) {
+    struct series_t parts[coin->num_windows];
+    /* only the tail was fetched, the rest of the range is in the cache */
+    uint8_t refresh = (coin->cache.header != NULL);
+    uint32_t empty = 0;
+    uint32_t i;
+    uint8_t kind;
+    
+    for (i = 0; i < coin->num_windows; i++) {
+        if (coin->windows[i].result > 0) {
+            return 1;
+        }
+        if (coin->windows[i].result < 0) {
+            empty++;
+        }
+    }
+    if ((empty == coin->num_windows) && refresh) {
+        /* nothing new yet */
+        return (cache_view(coin) != 0) ? 0 : -1;
+    }
+    if (empty == coin->num_windows) {
+        fprintf(messages, "error: invalid response or no data\n");
+        return -1;
+    }
+    if (empty > 0) {
+        fprintf(messages, "warning: no data for %u of the %u parts of the range\n", empty, coin->num_windows);
+    }
+    
+    for (kind = 0; kind < SERIES_COUNT; kind++) {
+        for (i = 0; i < coin->num_windows; i++) {
+            parts[i] = coin->windows[i].decoder.series[kind];
+        }
+        if (series_merge(&coin->series[kind], parts, coin->num_windows) == 0) {
+            return 1;
+        }
+    }
+    if ((coin->cache_path != NULL) && (cache_store(coin) == 0) && refresh) {
+        fprintf(messages, "error: updating the cache failed\n");
+        return 1;
+    }
+    if (refresh && (cache_view(coin) == 0)) {
+        fprintf(messages, "error: invalid response or no data\n");
+        return -1;
+    }
+    
+    return 0;
+}
+
+/* fills data with one value per day from the merged or cached series. returns 0 on success, 1 on failure and -1 if there was no data */
+static int8_t process_series (struct coin_t *coin) {
+    struct data_t *data = &coin->data;
+    const char *resolution;
+    size_t missing;
+    size_t day;
+    int8_t result;
+    
+    /* a cached coin's series are already there */
+    if (coin->num_windows > 0) {
+        result = merge_windows(coin);
+        if (result != 0) {
+            return result;
+        }
+    }
+    /* e.g. a query's slice of a superset that had no data in it */
+    if (coin->series[SERIES_PRICE].length == 0) {
+        fprintf(messages, "error: invalid response or no data\n");
+        return -1;
+    }
+    
+    detect_resolution(&coin->series[SERIES_PRICE], &resolution);
+    fprintf(messages, "data is in %s format\n", resolution);
+    
+    /* a day is valid if every column has data for it */
+    memset(data->valid, 0xff, sizeof(uint64_t) * ((data->num_entries + 63) / 64));
+    day = bucket_series(data, data->price, &coin->series[SERIES_PRICE]);
+    bucket_series(data, data->market_cap, &coin->series[SERIES_MARKET_CAP]);
+    bucket_series(data, data->volume, &coin->series[SERIES_VOLUME]);
+    if ((day == 0) || (next_valid(data->valid, 0, day) == day)) {
+        /* the series is all before or after the range */
+        fprintf(messages, "error: invalid response or no data\n");
+        return -1;
+    }
+    day--;
+    
+#if DEBUG
+    printf("recv: %zu expected: %zu\n", day, data->num_entries - 1);
+#endif  
+    if (day + 1 < data->num_entries) {
+        fprintf(messages, "warning: didn't receive enough data. recv: %zu expected: %zu\n", day, data->num_entries - 1);
+        data->num_entries = day + 1;
+    }
+    
+    missing = 0;
+    for (day = 0; day < data->num_entries; day++) {
+        missing += !(data->valid[day / 64] & ((uint64_t) 1 << (day % 64)));
+    }
+    if (missing > 0) {
+        fprintf(messages, "warning: no data for %zu of the %zu days, they're skipped\n", missing, data->num_entries);
+    }
+    
+    return 0;
+}
+
+static void free_data (struct data_t *data) {
+    free(data->block);
+    data->block = NULL;
+    data->timestamp = NULL;
+    data->price = NULL;
+    data->volume = NULL;
+    data->market_cap = NULL;
+    data->valid = NULL;
+}
+
+static void free_coin (struct coin_t *coin) {
+    uint32_t i;
+    uint8_t kind;
+    
+    for (i = 0; i < coin->num_windows; i++) {
+        for (kind = 0; kind < SERIES_COUNT; kind++) {
+            series_free(&coin->windows[i].decoder.series[kind]);
+        }
+        free(coin->windows[i].req);
+        free(coin->windows[i].key);
+    }
+    free(coin->windows);
+    coin->windows = NULL;
+    coin->num_windows = 0;
+    
+    for (kind = 0; kind < SERIES_COUNT; kind++) {
+        /* views into the cache aren't owned */
+        if (coin->series[kind].capacity == 0) {
+            memset(&coin->series[kind], 0, sizeof(coin->series[kind]));
+        }
+        series_free(&coin->series[kind]);
+    }
+    cache_close(&coin->cache);
+    free(coin->cache_path);
+    coin->cache_path = NULL;
+    free_data(&coin->data);
+}
+
+/* a coin's series kept in memory by the server, with the range they were fetched for */
+struct resident_t {
+    char *name;
+    struct series_t series[SERIES_COUNT];
+    int64_t range_begin;
+    int64_t range_end;
+    uint32_t resolution;
+    struct resident_t *next;
+};
+
+/* points the coin's series at the resident ones when they have its range. returns 1 if they do */
+static int8_t resident_serve (struct resident_t *resident, struct coin_t *coin) {
+    uint8_t kind;
+    
+    if ((resident->series[SERIES_PRICE].length == 0) || (resident->range_begin > coin->data.begin_timestamp) ||
+        (resident->range_end < coin->data.end_timestamp) || (resident->resolution > query_resolution(&coin->data))) {
+        return 0;
+    }
+    for (kind = 0; kind < SERIES_COUNT; kind++) {
+        series_slice(&resident->series[kind], coin->data.begin_timestamp, coin->data.end_timestamp, &coin->series[kind]);
+    }
+    
+    return coin->series[SERIES_PRICE].length > 0;
+}
+
+/* takes in the series the coin got. they're merged with the resident ones when the ranges overlap
+   and replace them when they don't, so that the resident series never have gaps */
+static void resident_update (struct resident_t *resident, struct coin_t *coin) {
+    struct series_t parts[2];
+    struct series_t merged;
+    int64_t begin = coin->data.begin_timestamp;
+    uint32_t resolution = series_resolution(&coin->series[SERIES_PRICE]);
+    int64_t end = cached_until(&coin->series[SERIES_PRICE], resolution, coin->data.end_timestamp);
+    uint8_t overlap = (resident->series[SERIES_PRICE].length > 0) && (begin <= resident->range_end) && (end >= resident->range_begin);
+    uint8_t kind;
+    
+    for (kind = 0; kind < SERIES_COUNT; kind++) {
+        /* the new pairs first, they win for timestamps that are in both */
+        parts[0] = coin->series[kind];
+        parts[1] = resident->series[kind];
+        memset(&merged, 0, sizeof(merged));
+        if (series_merge(&merged, parts, overlap ? 2 : 1) == 0) {
+            series_free(&merged);
+            /* what's there can't be trusted to match the range anymore */
+            resident->range_end = resident->range_begin;
+            return;
+        }
+        series_free(&resident->series[kind]);
+        resident->series[kind] = merged;
+    }
+    
+    if (overlap) {
+        resident->range_begin = (begin < resident->range_begin) ? begin : resident->range_begin;
+        resident->range_end = (end > resident->range_end) ? end : resident->range_end;
+        resident->resolution = (resolution > resident->resolution) ? resolution : resident->resolution;
+    } else {
+        resident->range_begin = begin;
+        resident->range_end = end;
+        resident->resolution = resolution;
+    }
+}
+
+/* resamples the coin's series over its range, as they came in, into bars of its bar size and prints them */
+static void print_bars (struct coin_t *coin) {
+    struct series_t price;
+    struct series_t volume;
+    struct bars_t bars;
+    double *volumes;
+    
+    series_slice(&coin->series[SERIES_PRICE], coin->data.begin_timestamp, coin->data.end_timestamp, &price);
+    series_slice(&coin->series[SERIES_VOLUME], coin->data.begin_timestamp, coin->data.end_timestamp, &volume);
+    
+    /* the volumes at the prices' timestamps, so that they're in step */
+    volumes = malloc(sizeof(double) * (price.length ? price.length : 1));
+    if (volumes == NULL) {
+        fprintf(messages, "error: malloc volumes\n");
+        return;
+    }
+    series_align(&volume, price.timestamp, price.length, volumes);
+    
+    if (bars_resample(&bars, price.timestamp, price.value, volumes, price.length,
+                      coin->data.begin_timestamp, bars_interval(coin->bar_size)) != 0) {
+        printf("Bars of %s (UTC): open, high, low, close, volume and VWAP\n", coin->bar_size);
+        bars_print(stdout, &bars);
+        printf("\n");
+        bars_free(&bars);
+    }
+    free(volumes);
+}
+
+/* called as soon as all of the coin's windows are in, while other coins may still be downloading */
+static void superset_done (struct coin_t *superset);
+
+static void coin_done (struct coin_t *coin) {
+    struct data_t *data = &coin->data;
+    struct results_t results;
+    
+    if (coin->members != NULL) {
+        superset_done(coin);
+        return;
+    }
+    
+    if (coin->show_name) {
+        fprintf(messages, "\ncoin: %s\n", coin->name);
+    }
+    
+    coin->result = process_series(coin);
+    if (coin->result != 0) {
+        if (coin->batch) {
+            print_record(coin->out, coin->name, data, &results, coin->result);
+        }
+        free_coin(coin);
+        return;
+    }
+    
+#if DEBUG   
+    printf("data processed\n");
+    printf("data:\n");
+    for (size_t i = 0; i < data->num_entries; i++) {
+        printf("%03zu: %15" PRId64 "\t%.4f\t%f\t%f\n", i, data->timestamp[i], data->price[i], data->volume[i], data->market_cap[i]);
+    }
+    
+    printf("\n");
+#endif
+
+    if (coin->resident != NULL) {
+        resident_update(coin->resident, coin);
+    }
+    
+    /* exercises */
+    exercise_a(data, &results);
+    exercise_b(data, &results);
+    exercise_c(data, &results, coin->principal);
+    
+    if (coin->batch) {
+        print_record(coin->out, coin->name, data, &results, coin->result);
+    } else {
+        print_results(data, &results, coin->principal);
+        if (coin->bar_size != NULL) {
+            print_bars(coin);
+        }
+    }
+    
+    free_coin(coin);
+}
+
+static void window_done (struct MemoryStruct *chunk, int failed, void *done_data) {
+    struct window_t *window = done_data;
+    (void) chunk;
+    
+    window->result = finish_json_data(window, failed);
+    
+    window->coin->windows_left--;
+    if (window->coin->windows_left == 0) {
+        coin_done(window->coin);
+    }
+}
+
+/* the columns of data in one block, each DATA_ALIGN aligned and padded with zeros up to the next boundary */
+static int alloc_data (struct data_t *data) {
+    size_t per_block = DATA_ALIGN / sizeof(double);
+    size_t stride = (data->num_entries + per_block - 1) / per_block * per_block;
+    size_t valid_words = ((stride + 63) / 64 + per_block - 1) / per_block * per_block;
+    size_t size = 4 * stride * sizeof(double) + valid_words * sizeof(uint64_t);
+    void *block = NULL;
+    char *columns;
+    
+    if (posix_memalign(&block, DATA_ALIGN, size) != 0) {
+        fprintf(messages, "error: malloc data\n");
+        return 1;
+    }
+    memset(block, 0, size);
+    data->block = block;
+    
+    columns = block;
+    data->timestamp = (int64_t *) columns;
+    data->price = (double *) (columns + stride * sizeof(double));
+    data->volume = (double *) (columns + stride * sizeof(double) * 2);
+    data->market_cap = (double *) (columns + stride * sizeof(double) * 3);
+    data->valid = (uint64_t *) (columns + stride * sizeof(double) * 4);
+    
+    return 0;
+}
+
+/* splits the coin's range into windows that come in hourly resolution and starts fetching them all */
+/* returns 0 on success, 1 on failure */
+static int8_t fetch_coin (struct fetch_t *fetch, struct coin_t *coin, const char *api_url) {
+    int64_t begin = coin->fetch_begin;
+    int64_t range = coin->data.end_timestamp - coin->fetch_begin;
+    struct window_t *window;
+    uint32_t i;
+    
+    coin->num_windows = (range + WINDOW_SECONDS - 1) / WINDOW_SECONDS;
+    if (coin->num_windows == 0) {
+        coin->num_windows = 1;
+    }
+    coin->windows = calloc(coin->num_windows, sizeof(struct window_t));
+    if (coin->windows == NULL) {
+        fprintf(messages, "error: malloc windows\n");
+        return 1;
+    }
+    coin->windows_left = coin->num_windows;
+    
+    for (i = 0; i < coin->num_windows; i++) {
+        window = &coin->windows[i];
+        window->coin = coin;
+        
+        /* the rest of the query is 52 chars and two timestamps of up to 20 digits */
+        window->req = malloc(sizeof(char) * (100 + strlen(api_url) + strlen(coin->name)));
+        if (window->req == NULL) {
+            fprintf(messages, "error: malloc req\n");
+            return 1;
+        }
+        
+        /* equal windows, sharing their bounds so that there's no gap between them, the duplicates are dropped when merging */
+        sprintf(window->req, "%s/coins/%s/market_chart/range?vs_currency=eur&from=%" PRIu64 "&to=%" PRIu64, 
+                                api_url, coin->name, begin + range * i / coin->num_windows, begin + range * (i + 1) / coin->num_windows);
+
+        fprintf(messages, "req: %s\n", window->req);
+        
+        /* coin-currency-from-to.json */
+        window->key = malloc(sizeof(char) * (60 + strlen(coin->name)));
+        if (window->key == NULL) {
+            fprintf(messages, "error: malloc key\n");
+            return 1;
+        }
+        sprintf(window->key, "%s-eur-%" PRIu64 "-%" PRIu64 ".json",
+                                coin->name, begin + range * i / coin->num_windows, begin + range * (i + 1) / coin->num_windows);
+        
+        if (process_json_data(fetch, window) != 0) {
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+/* how coins are fetched, from the command line */
+struct settings_t {
+    uint32_t max_concurrent;
+    uint32_t requests_per_minute;
+    uint32_t timeout;
+    const char *record_dir;
+    const char *replay_dir;
+    const char *cache_dir;
+    const char *api_url;
+};
+
+/* analyzes the coin right away if its range is cached, otherwise starts fetching it.
+   the fetch context is made when it's first needed. returns 0 on success, 1 on failure */
+static int8_t start_coin (struct coin_t *coin, struct fetch_t **fetch, const struct settings_t *settings) {
+    coin->fetch_begin = coin->data.begin_timestamp;
+    
+    /* a superset's range is only fetched, its queries get data blocks of their own */
+    if ((coin->members == NULL) && (alloc_data(&coin->data) != 0)) {
+        return 1;
+    }
+    
+    if (settings->cache_dir != NULL) {
+        /* coin-currency.bin */
+        coin->cache_path = malloc(sizeof(char) * (10 + strlen(settings->cache_dir) + strlen(coin->name)));
+        if (coin->cache_path == NULL) {
+            fprintf(messages, "error: malloc cache_path\n");
+            return 1;
+        }
+        sprintf(coin->cache_path, "%s/%s-eur.bin", settings->cache_dir, coin->name);
+        
+        /* analyzed right away, no need for curl or json */
+        if (cache_load(coin) != 0) {
+            coin_done(coin);
+            return 0;
+        }
+    }
+    
+    if (*fetch == NULL) {
+        /* kept for the process so that the requests reuse connections */
+        *fetch = fetch_init(settings->max_concurrent, settings->requests_per_minute);
+        if (*fetch == NULL) {
+            return 1;
+        }
+        fetch_timeout(*fetch, settings->timeout);
+        if ((settings->record_dir != NULL) && (fetch_record(*fetch, settings->record_dir) != 0)) {
+            return 1;
+        }
+        if ((settings->replay_dir != NULL) && (fetch_replay(*fetch, settings->replay_dir) != 0)) {
+            return 1;
+        }
+    }
+    
+    return fetch_coin(*fetch, coin, settings->api_url);
+}
+
+/* takes back the windows of a coin that are still queued or running, for when it's given up on before they're in */
+static void cancel_coin (struct fetch_t *fetch, struct coin_t *coin) {
+    struct window_t *window;
+    uint32_t i;
+    
+    for (i = 0; i < coin->num_windows; i++) {
+        window = &coin->windows[i];
+        /* the stream is there from when the window was added until it's done */
+        if (window->decoder.stream != NULL) {
+            fetch_cancel(fetch, window);
+            json_sax_stream_free(window->decoder.stream);
+            window->decoder.stream = NULL;
+            memory_release(&window->chunk);
+        }
+    }
+    free_coin(coin);
+}
+
+/* slices the superset's series for each of its queries and analyzes them */
+static void superset_done (struct coin_t *superset) {
+    struct coin_t *member;
+    struct results_t results;
+    int8_t result = 0;
+    uint8_t kind;
+    
+    if (superset->num_windows > 0) {
+        result = merge_windows(superset);
+    }
+    
+    for (member = superset->members; member != NULL; member = member->next_member) {
+        if ((result == 0) && (alloc_data(&member->data) != 0)) {
+            result = 1;
+        }
+        if (result != 0) {
+            member->result = result;
+            print_record(member->out, member->name, &member->data, &results, result);
+            free_coin(member);
+            continue;
+        }
+        for (kind = 0; kind < SERIES_COUNT; kind++) {
+            series_slice(&superset->series[kind], member->data.begin_timestamp, member->data.end_timestamp, &member->series[kind]);
+        }
+        coin_done(member);
+    }
+    
+    free_coin(superset);
+}
+
+/* by coin and then by the start of the range */
+static int compare_queries (const void *a, const void *b) {
+    const struct coin_t *query_a = *(struct coin_t * const *) a;
+    const struct coin_t *query_b = *(struct coin_t * const *) b;
+    int names = strcmp(query_a->name, query_b->name);
+    
+    if (names != 0) {
+        return names;
+    }
+    return (query_a->data.begin_timestamp > query_b->data.begin_timestamp) - (query_a->data.begin_timestamp < query_b->data.begin_timestamp);
+}
+
+/* groups batch queries of a coin whose ranges overlap, and come in the same resolution, into supersets
+   so that each group is fetched and decoded once. returns the number of supersets, or -1 on failure */
+static int32_t group_queries (struct coin_t *coins, uint32_t num_coins, struct coin_t **supersets) {
+    struct coin_t **sorted;
+    struct coin_t *superset = NULL;
+    struct coin_t *query;
+    struct coin_t *first = NULL;
+    int32_t num_supersets = 0;
+    uint32_t i;
+    
+    sorted = malloc(sizeof(struct coin_t *) * (num_coins ? num_coins : 1));
+    *supersets = calloc(num_coins / 2 + 1, sizeof(struct coin_t));
+    if ((sorted == NULL) || (*supersets == NULL)) {
+        fprintf(messages, "error: malloc supersets\n");
+        free(sorted);
+        return -1;
+    }
+    for (i = 0; i < num_coins; i++) {
+        sorted[i] = &coins[i];
+    }
+    qsort(sorted, num_coins, sizeof(struct coin_t *), compare_queries);
+    
+    for (i = 0; i < num_coins; i++) {
+        query = sorted[i];
+        /* queries of up to a day come in 5 minutes and a superset of them might not, so only longer ones are grouped */
+        if ((first != NULL) && (strcmp(first->name, query->name) == 0) &&
+            (query->data.begin_timestamp <= (superset ? superset : first)->data.end_timestamp) &&
+            (query_resolution(&query->data) == (60*60)) && (query_resolution(&first->data) == (60*60))) {
+            if (superset == NULL) {
+                /* a second query that overlaps the first, so they need a superset */
+                superset = &(*supersets)[num_supersets++];
+                superset->name = first->name;
+                superset->data = first->data;
+                superset->members = first;
+                first->in_superset = 1;
+            }
+            if (query->data.end_timestamp > superset->data.end_timestamp) {
+                superset->data.end_timestamp = query->data.end_timestamp;
+                superset->data.date_end = query->data.date_end;
+                superset->data.num_entries = days_between(&superset->data.date_begin, &superset->data.date_end);
+            }
+            query->next_member = superset->members;
+            superset->members = query;
+            query->in_superset = 1;
+            continue;
+        }
+        first = query;
+        superset = NULL;
+    }
+    
+    free(sorted);
+    return num_supersets;
+}
+
+/* parses a query's dates into data. returns 0 on success, 1 if they're invalid */
+static int8_t parse_range (struct data_t *data, const char *from, const char *to) {
+    /* parse dates from strings */
+    if ((parse_date(from, &(data->date_begin)) == 0) || (parse_date(to, &(data->date_end)) == 0)) {
+        fprintf(messages, "error: invalid date format\n");
+        return 1;
+    }
+    
+    if (0 == is_valid_date(&data->date_begin)) {
+        fprintf(messages, "error: invalid begin date\n");
+        return 1;
+    }
+    
+    if (0 == is_valid_date(&data->date_end)) {
+        fprintf(messages, "error: invalid end date\n");
+        return 1;
+    }       
+    
+    /* get unix timestamps and add 1 hour to end time to make sure the last day's data is included */
+    data->begin_timestamp = get_timestamp(&(data->date_begin));
+    data->end_timestamp = get_timestamp(&(data->date_end)) + (60*60);
+    
+    if (data->end_timestamp < data->begin_timestamp) {
+        fprintf(messages, "error: end date is before begin date\n");
+        return 1;
+    }
+
+    data->num_entries = days_between(&(data->date_begin), &(data->date_end));
+    if (data->num_entries == 0) {
+        fprintf(messages, "error: invalid date range\n");
+        return 1;
+    }
+    
+    return 0;
+}
+
+/* reads batch queries, one per line: coin from to [principal]. empty lines and ones starting with # are skipped.
+   the coins' names point into *text. returns the number of queries, or -1 on failure */
+static int32_t read_queries (FILE *file, char **text, struct coin_t **coins, uint32_t principal) {
+    size_t length = 0;
+    size_t capacity = 4096;
+    size_t got;
+    uint32_t num_lines = 1;
+    uint32_t line_number = 0;
+    int32_t num_coins = 0;
+    char *line;
+    char *next;
+    char *fields[4];
+    char *field;
+    char *save;
+    uint8_t num_fields;
+    char *buffer;
+    size_t i;
+    
+    *text = malloc(capacity);
+    if (*text == NULL) {
+        fprintf(messages, "error: malloc queries\n");
+        return -1;
+    }
+    while ((got = fread(*text + length, 1, capacity - length - 1, file)) > 0) {
+        length += got;
+        if (length + 1 == capacity) {
+            buffer = realloc(*text, capacity * 2);
+            if (buffer == NULL) {
+                fprintf(messages, "error: malloc queries\n");
+                return -1;
+            }
+            *text = buffer;
+            capacity *= 2;
+        }
+    }
+    (*text)[length] = 0;
+    
+    for (i = 0; i < length; i++) {
+        if ((*text)[i] == '\n') {
+            num_lines++;
+        }
+    }
+    *coins = calloc(num_lines, sizeof(struct coin_t));
+    if (*coins == NULL) {
+        fprintf(messages, "error: malloc coins\n");
+        return -1;
+    }
+    
+    for (line = *text; line != NULL; line = next) {
+        next = strchr(line, '\n');
+        if (next != NULL) {
+            *next++ = 0;
+        }
+        line_number++;
+        
+        num_fields = 0;
+        for (field = strtok_r(line, " \t\r", &save); (field != NULL) && (num_fields < 4); field = strtok_r(NULL, " \t\r", &save)) {
+            fields[num_fields++] = field;
+        }
+        if ((num_fields == 0) || (fields[0][0] == '#')) {
+            continue;
+        }
+        if ((num_fields < 3) || (parse_range(&(*coins)[num_coins].data, fields[1], fields[2]) != 0)) {
+            fprintf(messages, "error: invalid query on line %u\n", line_number);
+            continue;
+        }
+        
+        (*coins)[num_coins].name = fields[0];
+        (*coins)[num_coins].principal = (num_fields == 4) ? (uint32_t) atoi(fields[3]) : principal;
+        (*coins)[num_coins].batch = 1;
+        num_coins++;
+    }
+    
+    return num_coins;
+}
+
+/* a client of the server and what it has sent that isn't a whole line yet */
+struct client_t {
+    int fd;
+    FILE *out;
+    char buffer[1024];
+    size_t length;
+    uint32_t pending;           /* queries being fetched, the lines after them wait so that the answers stay in order */
+};
+
+/* a query that's being fetched, for the client it's answered to */
+struct query_t {
+    struct coin_t coin;
+    struct client_t *client;
+    struct query_t *next;
+};
+
+/* what the server keeps between queries */
+struct server_t {
+    struct resident_t *residents;
+    struct fetch_t *fetch;
+    struct query_t *queries;    /* being fetched */
+    const struct settings_t *settings;
+    uint32_t principal;
+};
+
+/* answers a query line (coin from to [principal]) with a batch record, right away from the resident series
+   when they have the range. otherwise it's fetched by the server's loop and answered when it's in */
+static void serve_query (struct server_t *server, struct client_t *client, char *line) {
+    struct resident_t *resident;
+    struct query_t *query;
+    struct coin_t *coin;
+    char *fields[4];
+    char *field;
+    char *save;
+    uint8_t num_fields = 0;
+    
+    for (field = strtok_r(line, " \t\r", &save); (field != NULL) && (num_fields < 4); field = strtok_r(NULL, " \t\r", &save)) {
+        fields[num_fields++] = field;
+    }
+    if (num_fields == 0) {
+        return;
+    }
+    
+    query = calloc(1, sizeof(struct query_t));
+    if (query == NULL) {
+        fprintf(messages, "error: malloc query\n");
+        return;
+    }
+    coin = &query->coin;
+    if ((num_fields < 3) || (parse_range(&coin->data, fields[1], fields[2]) != 0)) {
+        fprintf(client->out, "error: invalid query\n");
+        fflush(client->out);
+        free(query);
+        return;
+    }
+    /* the line is gone by the time the fetch is done */
+    coin->name = strdup(fields[0]);
+    if (coin->name == NULL) {
+        fprintf(messages, "error: malloc name\n");
+        free(query);
+        return;
+    }
+    coin->principal = (num_fields == 4) ? (uint32_t) atoi(fields[3]) : server->principal;
+    coin->batch = 1;
+    coin->out = client->out;
+    
+    for (resident = server->residents; resident != NULL; resident = resident->next) {
+        if (strcmp(resident->name, coin->name) == 0) {
+            break;
+        }
+    }
+    if (resident == NULL) {
+        resident = calloc(1, sizeof(struct resident_t));
+        if ((resident == NULL) || ((resident->name = strdup(coin->name)) == NULL)) {
+            fprintf(messages, "error: malloc resident\n");
+            free(resident);
+            free(coin->name);
+            free(query);
+            return;
+        }
+        resident->next = server->residents;
+        server->residents = resident;
+    }
+    
+    if (resident_serve(resident, coin) != 0) {
+        if (alloc_data(&coin->data) == 0) {
+            coin_done(coin);
+        } else {
+            free_coin(coin);
+        }
+    } else {
+        coin->resident = resident;
+        if (start_coin(coin, &server->fetch, server->settings) != 0) {
+            fprintf(client->out, "error: can't start fetching %s\n", coin->name);
+            /* some of its windows may be queued already */
+            if (server->fetch != NULL) {
+                cancel_coin(server->fetch, coin);
+            } else {
+                free_coin(coin);
+            }
+        } else if (coin->windows_left > 0) {
+            query->client = client;
+            query->next = server->queries;
+            server->queries = query;
+            client->pending++;
+            return;
+        }
+    }
+    fflush(client->out);
+    free(coin->name);
+    free(query);
+}
+
+/* answers the client's whole lines in order, up to one that has to be fetched first */
+static void client_serve (struct server_t *server, struct client_t *client) {
+    char *line;
+    char *end;
+    
+    for (line = client->buffer; (client->pending == 0) && ((end = strchr(line, '\n')) != NULL); line = end + 1) {
+        *end = 0;
+        serve_query(server, client, line);
+    }
+    /* the rest waits for more to be read or the fetch to be done, terminated */
+    client->length -= line - client->buffer;
+    memmove(client->buffer, line, client->length + 1);
+}
+
+/* sends the answers to the queries that are in, and goes on with the lines their clients sent after them */
+static void reap_queries (struct server_t *server) {
+    struct query_t **link;
+    struct query_t *query;
+    struct client_t *client;
+    
+    for (link = &server->queries; *link != NULL; ) {
+        query = *link;
+        if (query->coin.windows_left > 0) {
+            link = &query->next;
+            continue;
+        }
+        *link = query->next;
+        client = query->client;
+        fflush(client->out);
+        free(query->coin.name);
+        free(query);
+        if (--client->pending == 0) {
+            /* any new queries go in front, behind the link */
+            client_serve(server, client);
+        }
+    }
+}
+
+/* keeps the series it fetched in memory and answers queries from them over a unix socket, one line per query
+   and one batch record per answer. returns 1 if it couldn't be started */
+static int8_t run_server (const char *path, const struct settings_t *settings, uint32_t principal) {
+    struct server_t server;
+    struct sockaddr_un address;
+    struct client_t *clients[SERVER_MAX_CLIENTS];
+    struct pollfd fds[SERVER_MAX_CLIENTS + 1];
+    struct curl_waitfd wait_fds[SERVER_MAX_CLIENTS + 1];
+    struct client_t *client;
+    uint32_t num_clients = 0;
+    uint32_t i;
+    ssize_t got;
+    int listen_fd;
+    int fd;
+    
+    memset(&server, 0, sizeof(server));
+    server.settings = settings;
+    server.principal = principal;
+    
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(messages, "error: socket path too long\n");
+        return 1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        fprintf(messages, "error: socket\n");
+        return 1;
+    }
+    /* a socket left behind by an earlier run */
+    unlink(path);
+    if ((bind(listen_fd, (struct sockaddr *) &address, sizeof(address)) != 0) || (listen(listen_fd, 16) != 0)) {
+        fprintf(messages, "error: can't listen on %s\n", path);
+        close(listen_fd);
+        return 1;
+    }
+    /* a client that goes away mid-answer shouldn't take the server with it */
+    signal(SIGPIPE, SIG_IGN);
+    fprintf(messages, "listening on %s\n", path);
+    
+    for (;;) {
+        fds[0].fd = listen_fd;
+        fds[0].events = (num_clients < SERVER_MAX_CLIENTS) ? POLLIN : 0;
+        for (i = 0; i < num_clients; i++) {
+            fds[i + 1].fd = clients[i]->fd;
+            /* nothing more is read from a client until its query is in */
+            fds[i + 1].events = (clients[i]->pending == 0) ? POLLIN : 0;
+            fds[i + 1].revents = 0;
+        }
+        
+        if ((server.fetch != NULL) && fetch_pending(server.fetch)) {
+            /* the sockets are waited on along with the transfers, which move on in the meantime */
+            for (i = 0; i < num_clients + 1; i++) {
+                wait_fds[i].fd = fds[i].fd;
+                wait_fds[i].events = (fds[i].events & POLLIN) ? CURL_WAIT_POLLIN : 0;
+                wait_fds[i].revents = 0;
+            }
+            fetch_step(server.fetch, wait_fds, num_clients + 1, -1);
+            for (i = 0; i < num_clients + 1; i++) {
+                fds[i].revents = (wait_fds[i].revents & CURL_WAIT_POLLIN) ? POLLIN : 0;
+            }
+            reap_queries(&server);
+        } else if (poll(fds, num_clients + 1, -1) < 0) {
+            continue;
+        }
+        
+        for (i = num_clients; i > 0; i--) {
+            client = clients[i - 1];
+            if ((fds[i].revents == 0) || (client->pending > 0)) {
+                continue;
+            }
+            if (client->length < sizeof(client->buffer) - 1) {
+                got = read(client->fd, &client->buffer[client->length], sizeof(client->buffer) - client->length - 1);
+                if (got > 0) {
+                    client->length += got;
+                    client->buffer[client->length] = 0;
+                    /* answer every whole line, keep the rest for the next read */
+                    client_serve(&server, client);
+                    if ((client->pending > 0) || (client->length < sizeof(client->buffer) - 1)) {
+                        continue;
+                    }
+                    fprintf(client->out, "error: line too long\n");
+                }
+            } else {
+                fprintf(client->out, "error: line too long\n");
+            }
+            /* gone, or sent a line that can't be a query */
+            fclose(client->out);
+            free(client);
+            clients[i - 1] = clients[--num_clients];
+        }
+        
+        if (fds[0].revents & POLLIN) {
+            fd = accept(listen_fd, NULL, NULL);
+            if (fd < 0) {
+                continue;
+            }
+            client = calloc(1, sizeof(struct client_t));
+            if ((client == NULL) || ((client->out = fdopen(fd, "w")) == NULL)) {
+                fprintf(messages, "error: malloc client\n");
+                free(client);
+                close(fd);
+                continue;
+            }
+            client->fd = fd;
+            clients[num_clients++] = client;
+        }
+    }
+    
+    return 0;
+}
+
+static double elapsed_ms (const struct timespec *start, const struct timespec *stop) {
+    return (stop->tv_sec - start->tv_sec) * 1000.0 + (stop->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/* times the exercises, and the bucketing of 5 minute data into days, over made up series of growing length.
+   the time per point should stay about the same as they grow. returns 0 on success, 1 on failure */
+static int8_t run_bench (void) {
+    struct data_t points;
+    struct data_t days;
+    struct series_t series;
+    struct results_t results;
+    struct timespec start;
+    struct timespec stop;
+    double exercises_ms;
+    double bucketing_ms;
+    double price = 1000;
+    size_t n;
+    size_t i;
+    
+    printf("points\texercises ms\tns/point\tbucketing ms\tns/point\n");
+    for (n = BENCH_MIN_POINTS; n <= BENCH_MAX_POINTS; n *= 2) {
+        memset(&points, 0, sizeof(points));
+        memset(&days, 0, sizeof(days));
+        memset(&series, 0, sizeof(series));
+        
+        /* the exercises take every point as a day of their own, the bucketing takes them as 5 minutes apart */
+        points.num_entries = n;
+        days.date_begin.year = 2013;
+        days.date_begin.month = 4;
+        days.date_begin.day = 28;
+        days.num_entries = n / (24*12) + 1;
+        series.timestamp = malloc(sizeof(int64_t) * n);
+        series.value = malloc(sizeof(double) * n);
+        if ((alloc_data(&points) != 0) || (alloc_data(&days) != 0) || (series.timestamp == NULL) || (series.value == NULL)) {
+            fprintf(messages, "error: malloc bench\n");
+            free_data(&points);
+            free_data(&days);
+            series_free(&series);
+            return 1;
+        }
+        series.length = n;
+        series.capacity = n;
+        
+        /* a random walk */
+        srand(n);
+        for (i = 0; i < n; i++) {
+            price *= 1 + (rand() / (double) RAND_MAX - 0.5) * 0.02;
+            points.timestamp[i] = get_timestamp(&days.date_begin) + (int64_t) i * (5*60);
+            points.price[i] = price;
+            points.volume[i] = rand();
+            points.market_cap[i] = price * 1000000;
+            series.timestamp[i] = points.timestamp[i];
+            series.value[i] = price;
+        }
+        memset(points.valid, 0xff, sizeof(uint64_t) * ((n + 63) / 64));
+        memset(days.valid, 0xff, sizeof(uint64_t) * ((days.num_entries + 63) / 64));
+        
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        exercise_a(&points, &results);
+        exercise_b(&points, &results);
+        exercise_c(&points, &results, 1000);
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        exercises_ms = elapsed_ms(&start, &stop);
+        
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        bucket_series(&days, days.price, &series);
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        bucketing_ms = elapsed_ms(&start, &stop);
+        
+        printf("%zu\t%.3f\t%.2f\t%.3f\t%.2f\n", n, exercises_ms, exercises_ms * 1000000 / n, bucketing_ms, bucketing_ms * 1000000 / n);
+        
+        free_data(&points);
+        free_data(&days);
+        series_free(&series);
+    }
+    
+    return 0;
+}
+
+int main (int argc, char *argv[]) {
+    uint32_t principal = 1000;
+    struct settings_t settings = { FETCH_MAX_CONCURRENT, FETCH_REQUESTS_PER_MINUTE, FETCH_STALL_TIMEOUT, NULL, NULL, NULL, NULL };
+    const char *batch_file = NULL;
+    const char *server_path = NULL;
+    const char *bar_size = NULL;
+    FILE *file;
+    char *queries = NULL;
+    int32_t num_queries;
+    int8_t result = 0;
+    
+    struct data_t data;
+
+    struct fetch_t *fetch = NULL;
+    struct coin_t *coins;
+    struct coin_t *supersets = NULL;
+    struct coin_t *member;
+    int32_t num_supersets = 0;
+    uint32_t num_coins;
+    uint32_t i;
+    char *coin_names = NULL;
+    char *name;
+    char *prog = argv[0];
+    
+    messages = stdout;
+
+#if DEBUG   
+    for (uint8_t arg = 0; arg < argc; arg++) {
+        printf("%s ", argv[arg]);
+    }
+    printf("\n");
+#endif
+    
+    /* options come before the positional arguments */
+    while ((argc > 1) && (argv[1][0] == '-')) {
+        if ((strcmp(argv[1], "-j") == 0) && (argc > 2) && (atoi(argv[2]) > 0)) {
+            /* how many coins to fetch at the same time */
+            settings.max_concurrent = atoi(argv[2]);
+            argc -= 2;
+            argv += 2;
+        } else if ((strcmp(argv[1], "-r") == 0) && (argc > 2) && (atoi(argv[2]) >= 0)) {
+            /* requests per minute the API allows, 0 for no limit */
+            settings.requests_per_minute = atoi(argv[2]);
+            argc -= 2;
+            argv += 2;
+        } else if ((strcmp(argv[1], "-t") == 0) && (argc > 2) && (atoi(argv[2]) > 0)) {
+            /* seconds a transfer may go without connecting or without data */
+            settings.timeout = atoi(argv[2]);
+            argc -= 2;
+            argv += 2;
+        } else if ((strcmp(argv[1], "-R") == 0) && (argc > 2)) {
+            /* save the responses to a directory */
+            settings.record_dir = argv[2];
+            argc -= 2;
+            argv += 2;
+        } else if ((strcmp(argv[1], "-P") == 0) && (argc > 2)) {
+            /* play saved responses back instead of downloading them */
+            settings.replay_dir = argv[2];
+            argc -= 2;
+            argv += 2;
+        } else if ((strcmp(argv[1], "-C") == 0) && (argc > 2)) {
+            /* keep the series in binary files, so that ranges already fetched don't need to be fetched again */
+            settings.cache_dir = argv[2];
+            argc -= 2;
+            argv += 2;
+        } else if ((strcmp(argv[1], "-b") == 0) && (argc > 2)) {
+            /* queries from a file, - for stdin */
+            batch_file = argv[2];
+            argc -= 2;
+            argv += 2;
+        } else if ((strcmp(argv[1], "-B") == 0) && (argc > 2) && (bars_interval(argv[2]) > 0)) {
+            /* also print the range as bars of this size */
+            bar_size = argv[2];
+            argc -= 2;
+            argv += 2;
+        } else if (strcmp(argv[1], "-T") == 0) {
+            /* time the analysis over made up series instead */
+            return run_bench();
+        } else if ((strcmp(argv[1], "-s") == 0) && (argc > 2)) {
+            /* serve queries over a unix socket */
+            server_path = argv[2];
+            argc -= 2;
+            argv += 2;
+        } else {
+            fprintf(messages, "error: invalid option %s\n", argv[1]);
+            return 1;
+        }
+    }
+    
+    /* Get json files */
+    settings.api_url = getenv("MONEYMAKER_API_URL");
+    if (settings.api_url == NULL) {
+        settings.api_url = API_URL;
+    }
+    
+    if (server_path != NULL) {
+        messages = stderr;
+        return run_server(server_path, &settings, principal);
+    }
+    
+    if (batch_file != NULL) {
+        /* stdout is for the records */
+        messages = stderr;
+        
+        file = (strcmp(batch_file, "-") == 0) ? stdin : fopen(batch_file, "r");
+        if (file == NULL) {
+            fprintf(messages, "error: can't open %s\n", batch_file);
+            return 1;
+        }
+        num_queries = read_queries(file, &queries, &coins, principal);
+        if (file != stdin) {
+            fclose(file);
+        }
+        if (num_queries < 0) {
+            return 1;
+        }
+        num_coins = num_queries;
+        
+        /* overlapping queries of a coin are fetched once */
+        num_supersets = group_queries(coins, num_coins, &supersets);
+        if (num_supersets < 0) {
+            return 1;
+        }
+    } else if (argc >= 4) {
+        /* first argument is coin_name, or a comma separated list of them */
+        printf("coin: %s\n", argv[1]);
+
+        /* second is begin date, third is end date */
+        if (parse_range(&data, argv[2], argv[3]) != 0) {
+            return 1;
+        }
+        
+        printf("begin date: %s (%lld)\n", argv[2], data.begin_timestamp);
+        printf("end date: %s (%lld)\n", argv[3], data.end_timestamp);
+        printf("days: %zu\n", data.num_entries);
+    
+        /* optional fourth argument is the amount of money to use for exercise C. defaults to something */
+        if (argc == 5) {
+            principal = atoi(argv[4]);
+        }
+        
+        coin_names = strdup(argv[1]);
+        if (coin_names == NULL) {
+            fprintf(messages, "error: malloc coin_names\n");
+            return 1;
+        }
+        num_coins = 1;
+        for (name = coin_names; *name != 0; name++) {
+            if (*name == ',') {
+                num_coins++;
+            }
+        }
+        coins = calloc(num_coins, sizeof(struct coin_t));
+        if (coins == NULL) {
+            fprintf(messages, "error: malloc coins\n");
+            return 1;
+        }
+        
+        name = strtok(coin_names, ",");
+        for (i = 0; (i < num_coins) && (name != NULL); i++, name = strtok(NULL, ",")) {
+            coins[i].name = name;
+            coins[i].data = data;
+            coins[i].principal = principal;
+            coins[i].show_name = (num_coins > 1);
+            coins[i].bar_size = bar_size;
+        }
+        num_coins = i;
+    } else {
+        fprintf(messages, "error: invalid number of arguments\nusage: %s [-j max_concurrent] [-r requests_per_minute] [-t timeout] [-R record_dir | -P replay_dir] [-C cache_dir] [-B bar_size] [coin_name[,coin_name...]] [from] [to]\n"
+               "       %s [options] -b queries_file\n       %s [options] -s socket_path\n       %s -T\ne.g.: %s monero 2021-09-16 2021-11-01\n",
+                prog, prog, prog, prog, prog);
+        return 1;
+    }
+    
+    for (i = 0; i < num_coins; i++) {
+        coins[i].priority = i;
+        coins[i].out = stdout;
+    }
+    for (i = 0; i < (uint32_t) num_supersets; i++) {
+        /* the first of its queries to be fetched sets the superset's priority */
+        supersets[i].priority = supersets[i].members->priority;
+        for (member = supersets[i].members->next_member; member != NULL; member = member->next_member) {
+            if (member->priority < supersets[i].priority) {
+                supersets[i].priority = member->priority;
+            }
+        }
+        if (start_coin(&supersets[i], &fetch, &settings) != 0) {
+            return 1;
+        }
+    }
+    for (i = 0; i < num_coins; i++) {
+        if (coins[i].in_superset) {
+            continue;
+        }
+        if (start_coin(&coins[i], &fetch, &settings) != 0) {
+            return 1;
+        }
+    }
+    
+    /* download and decode them all, each is analyzed as soon as it's in */
+    if (fetch != NULL) {
+        fetch_run(fetch);
+    }
+    
+    for (i = 0; i < num_coins; i++) {
+        if (coins[i].result > 0) {
+            result = 1;
+        }
+    }
+    free(supersets);
+    free(coins);
+    free(coin_names);
+    free(queries);
+    fetch_cleanup(fetch);
+    memory_pool_cleanup();
+    
+    return result;
 }
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "series.h"
+
+/* makes room for at least capacity pairs, growing geometrically. returns 1 on success */
+static int8_t series_reserve(struct series_t *series, size_t capacity) {
+    size_t new_capacity = series->capacity ? series->capacity : 256;
+    int64_t *timestamp;
+    double *value;
+    
+    if (capacity <= series->capacity) {
+        return 1;
+    }
+    while (new_capacity < capacity) {
+        new_capacity *= 2;
+    }
+    
+    timestamp = realloc(series->timestamp, sizeof(int64_t) * new_capacity);
+    if (timestamp == NULL) {
+        fprintf(stderr, "error: malloc series\n");
+        return 0;
+    }
+    series->timestamp = timestamp;
+    
+    value = realloc(series->value, sizeof(double) * new_capacity);
+    if (value == NULL) {
+        fprintf(stderr, "error: malloc series\n");
+        return 0;
+    }
+    series->value = value;
+    series->capacity = new_capacity;
+    
+    return 1;
+}
+
+/* returns 1 on success */
+int8_t series_append(struct series_t *series, int64_t timestamp, double value) {
+    if ((series->length == series->capacity) && (series_reserve(series, series->length + 1) == 0)) {
+        return 0;
+    }
+    series->timestamp[series->length] = timestamp;
+    series->value[series->length] = value;
+    series->length++;
+    
+    return 1;
+}
+
+/* the API sends the pairs in order, so this is only a fallback and insertion sort does */
+static void series_sort(struct series_t *series) {
+    int64_t timestamp;
+    double value;
+    size_t i, j;
+    
+    for (i = 1; i < series->length; i++) {
+        timestamp = series->timestamp[i];
+        value = series->value[i];
+        for (j = i; (j > 0) && (series->timestamp[j - 1] > timestamp); j--) {
+            series->timestamp[j] = series->timestamp[j - 1];
+            series->value[j] = series->value[j - 1];
+        }
+        /* sorted series aren't written to, they may be read-only views */
+        if (j != i) {
+            series->timestamp[j] = timestamp;
+            series->value[j] = value;
+        }
+    }
+}
+
+/* merges the parts (e.g. responses for adjoining windows of a range) into one series ordered by timestamp,
+   keeping only the first pair of any timestamp. returns 1 on success */
+int8_t series_merge(struct series_t *merged, struct series_t *parts, size_t num_parts) {
+    size_t *next;
+    size_t total = 0;
+    size_t part, best;
+    int64_t timestamp;
+    
+    next = calloc(num_parts ? num_parts : 1, sizeof(size_t));
+    if (next == NULL) {
+        fprintf(stderr, "error: malloc series merge\n");
+        return 0;
+    }
+    
+    for (part = 0; part < num_parts; part++) {
+        series_sort(&parts[part]);
+        total += parts[part].length;
+    }
+    merged->length = 0;
+    if (series_reserve(merged, total) == 0) {
+        free(next);
+        return 0;
+    }
+    
+    /* only a few parts, so just look for the earliest head each time */
+    for (;;) {
+        best = num_parts;
+        for (part = 0; part < num_parts; part++) {
+            if ((next[part] < parts[part].length)
+                    && ((best == num_parts) || (parts[part].timestamp[next[part]] < parts[best].timestamp[next[best]]))) {
+                best = part;
+            }
+        }
+        if (best == num_parts) {
+            break;
+        }
+        
+        timestamp = parts[best].timestamp[next[best]];
+        if ((merged->length == 0) || (merged->timestamp[merged->length - 1] != timestamp)) {
+            merged->timestamp[merged->length] = timestamp;
+            merged->value[merged->length] = parts[best].value[next[best]];
+            merged->length++;
+        }
+        next[best]++;
+    }
+    
+    free(next);
+    
+    return 1;
+}
+
+/* the series' values at the given timestamps, each the value at that timestamp or the last one before it
+   (the first one for timestamps before the series starts). both have to be in order */
+void series_align(const struct series_t *series, const int64_t *timestamp, size_t length, double *values) {
+    size_t j = 0;
+    size_t i;
+    
+    for (i = 0; i < length; i++) {
+        while ((j + 1 < series->length) && (series->timestamp[j + 1] <= timestamp[i])) {
+            j++;
+        }
+        values[i] = series->length ? series->value[j] : 0;
+    }
+}
+
+/* points view at the pairs from begin to end, both included, found by binary search. the view isn't owned, capacity 0 */
+void series_slice(const struct series_t *series, int64_t begin, int64_t end, struct series_t *view) {
+    size_t low = 0;
+    size_t high = series->length;
+    size_t mid;
+    size_t first;
+    
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        if (series->timestamp[mid] < begin) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    first = low;
+    
+    high = series->length;
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        if (series->timestamp[mid] <= end) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    
+    view->timestamp = series->timestamp + first;
+    view->value = series->value + first;
+    view->length = low - first;
+    view->capacity = 0;
+}
+
+void series_free(struct series_t *series) {
+    free(series->timestamp);
+    free(series->value);
+    series->timestamp = NULL;
+    series->value = NULL;
+    series->length = 0;
+    series->capacity = 0;
+}
\ No newline at end of file
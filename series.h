@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* [timestamp, value] pairs as they come from the API, in two columns */
+struct series_t {
+    int64_t *timestamp;
+    double *value;
+    size_t length;
+    size_t capacity;
+};
+
+int8_t series_append(struct series_t *series, int64_t timestamp, double value);
+int8_t series_merge(struct series_t *merged, struct series_t *parts, size_t num_parts);
+void series_slice(const struct series_t *series, int64_t begin, int64_t end, struct series_t *view);
+void series_align(const struct series_t *series, const int64_t *timestamp, size_t length, double *values);
+void series_free(struct series_t *series);
\ No newline at end of file
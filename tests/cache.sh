@@ -0,0 +1,63 @@
+#!/bin/sh
+# a query that doesn't use the cache file mustn't throw away the range that's in it:
+# a short range in another resolution leaves it as it is, an adjoining one in the same resolution is merged into it.
+# a refresh of its tail shorter than a day comes in 5 minutes and mustn't be mixed into the hourly file
+moneymaker=$(realpath "$1")
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+mkdir "$tmp/replay" "$tmp/empty" "$tmp/cache"
+failed=0
+
+# record from to step: pairs every step seconds from from to to, both included
+record() {
+    python3 - "$tmp/replay/bitcoin-eur-$1-$2.json" "$1" "$2" "$3" <<'PY'
+import json, sys
+begin, end, step = int(sys.argv[2]), int(sys.argv[3]), int(sys.argv[4])
+pairs = {"prices": [], "market_caps": [], "total_volumes": []}
+for t in range(begin, end + 1, step):
+    pairs["prices"].append([t * 1000, 100 + (t // 86400) % 7])
+    pairs["market_caps"].append([t * 1000, 1000])
+    pairs["total_volumes"].append([t * 1000, 10])
+json.dump(pairs, open(sys.argv[1], "w"))
+PY
+}
+
+# expect name dir from to: the query has to come out ok with the responses in dir
+expect() {
+    status=$(echo "bitcoin $3 $4" | "$moneymaker" -P "$2" -C "$tmp/cache" -b - 2>/dev/null | cut -f 4)
+    if [ "$status" != "ok" ]; then
+        echo "FAIL $1: record says '$status' instead of 'ok'"
+        failed=1
+    fi
+}
+
+# 2021-01-10 to 2021-01-20 hourly, an hour of 2021-01-05 in 5 minutes and 2021-01-01 to 2021-01-10 hourly.
+# the latter two start before what's cached, so they're fetched whole instead of as a refresh of its tail
+record 1610236800 1611104400 3600
+record 1609804800 1609808400 300
+record 1609459200 1610240400 3600
+
+expect "first fetch" "$tmp/replay" 2021-01-10 2021-01-20
+expect "short range in 5 minutes" "$tmp/replay" 2021-01-05 2021-01-05
+expect "cached range kept" "$tmp/empty" 2021-01-10 2021-01-20
+expect "adjoining range" "$tmp/replay" 2021-01-01 2021-01-10
+expect "merged range" "$tmp/empty" 2021-01-01 2021-01-20
+
+# the day after what's cached
+record 1611104400 1611190800 300
+expect "tail in 5 minutes" "$tmp/replay" 2021-01-01 2021-01-21
+if ! python3 - "$tmp/cache/bitcoin-eur.bin" <<'PY'
+import struct, sys
+data = open(sys.argv[1], "rb").read()
+resolution, count = struct.unpack_from("<IQ", data, 12)
+timestamps = struct.unpack_from("<%dq" % count, data, 64)
+spacing = min(b - a for a, b in zip(timestamps, timestamps[1:]))
+if resolution != 3600 or spacing < 3600 or timestamps[-1] < 1611187200:
+    print("FAIL tail in 5 minutes: cache resolution %d, samples down to %d s apart, last at %d" % (resolution, spacing, timestamps[-1]))
+    sys.exit(1)
+PY
+then
+    failed=1
+fi
+
+exit $failed
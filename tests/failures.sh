@@ -0,0 +1,46 @@
+#!/bin/sh
+# a transfer that fails has to fail the query, not pass as a range without data:
+# an HTTP error status, a connection that can't be made and a response missing from a replay
+moneymaker=$(realpath "$1")
+tmp=$(mktemp -d)
+port=$((20000 + $$ % 10000))
+failed=0
+
+cleanup() {
+    [ -n "$server" ] && kill "$server" 2>/dev/null
+    rm -rf "$tmp"
+}
+trap cleanup EXIT
+
+# answers every request with 404, as there's nothing to serve
+mkdir "$tmp/empty"
+python3 -m http.server "$port" --bind 127.0.0.1 --directory "$tmp/empty" >/dev/null 2>&1 &
+server=$!
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    curl -s -o /dev/null "http://127.0.0.1:$port/" && break
+    sleep 0.2
+done
+
+# expect name status [options]: runs a single query and a batch of it, the first has to exit 1 and the record has the status
+expect() {
+    name=$1
+    status=$2
+    shift 2
+    if "$@" -r 0 bitcoin 2021-01-01 2021-01-10 >/dev/null 2>&1; then
+        echo "FAIL $name: exited 0"
+        failed=1
+    fi
+    record=$(echo "bitcoin 2021-01-01 2021-01-10" | "$@" -r 0 -b - 2>/dev/null | cut -f 4)
+    if [ "$record" != "$status" ]; then
+        echo "FAIL $name: record says '$record' instead of '$status'"
+        failed=1
+    fi
+}
+
+MONEYMAKER_API_URL=http://127.0.0.1:$port/api/v3 expect "HTTP 404" failed "$moneymaker"
+# nothing listens on port 1
+MONEYMAKER_API_URL=http://127.0.0.1:1/api/v3 expect "connection error" failed "$moneymaker"
+mkdir "$tmp/replay"
+expect "missing recording" failed "$moneymaker" -P "$tmp/replay"
+
+exit $failed
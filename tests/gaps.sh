@@ -0,0 +1,41 @@
+#!/bin/sh
+# days without data, at the start of the range and in between, are skipped instead of taking another day's values
+moneymaker=$(realpath "$1")
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+failed=0
+
+# hourly pairs for 2021-01-01 to 2021-01-10 with the first two days and 2021-01-07 missing,
+# every pair of a day has the day's price and volume
+python3 - "$tmp/bitcoin-eur-1609459200-1610240400.json" <<'PY'
+import json, sys
+price = [0, 0, 10, 9, 8, 12, 0, 15, 14, 13]
+volume = [0, 0, 9000, 1000, 1000, 1000, 0, 1000, 1000, 1000]
+begin = 1609459200
+pairs = {"prices": [], "market_caps": [], "total_volumes": []}
+for hour in range(9 * 24 + 1):
+    day = hour // 24
+    if day in (0, 1, 6):
+        continue
+    ms = (begin + hour * 3600) * 1000
+    pairs["prices"].append([ms, price[day]])
+    pairs["market_caps"].append([ms, price[day] * 1000])
+    pairs["total_volumes"].append([ms, volume[day]])
+json.dump(pairs, open(sys.argv[1], "w"))
+PY
+
+"$moneymaker" -P "$tmp" bitcoin 2021-01-01 2021-01-10 > "$tmp/out" 2>&1
+
+check() {
+    if ! grep -q "$1" "$tmp/out"; then
+        echo "FAIL: no '$1' in"
+        cat "$tmp/out"
+        failed=1
+    fi
+}
+check "no data for 3 of the 10 days"
+check "Longest bear trend of 2 days between 2021-01-03 and 2021-01-05"
+check "Highest trading volume 9000.000000 on 2021-01-03"
+check "Buy on: 2021-01-05	Sell on: 2021-01-08"
+
+exit $failed
@@ -0,0 +1,189 @@
+/* json.c's number conversion against strtod: every double has to come out the same to the bit, whichever of
+   Clinger's fast path, Eisel-Lemire or the strtod fallback it takes, through the tree, the events and the series */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "../json.h"
+
+static int failures = 0;
+
+/* what the events made of a document */
+struct got_t {
+    json_type type;
+    json_int_t integer;
+    double dbl;
+    size_t count;
+};
+
+static int got_integer (json_int_t integer, void *user_data) {
+    struct got_t *got = user_data;
+
+    got->type = json_integer;
+    got->integer = integer;
+    got->count++;
+    return 1;
+}
+
+static int got_dbl (double dbl, void *user_data) {
+    struct got_t *got = user_data;
+
+    got->type = json_double;
+    got->dbl = dbl;
+    got->count++;
+    return 1;
+}
+
+static int got_series (const json_int_t *first, const double *second, size_t count, void *user_data) {
+    struct got_t *got = user_data;
+
+    (void) first;
+    got->type = json_double;
+    got->dbl = second[count - 1];
+    got->count += count;
+    return 1;
+}
+
+static int same_double (double a, double b) {
+    return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+/* the number through the tree and the events, each has to be of the type and value expected */
+static void check (const char *text, json_type type, json_int_t integer, double dbl) {
+    json_settings settings;
+    json_sax_handler handler;
+    json_value *value;
+    struct got_t got;
+    char json[512];
+    char error[json_error_max];
+
+    value = json_parse((const json_char *) text, strlen(text));
+    if ((value == NULL) || (value->type != type) ||
+        ((type == json_integer) ? (value->u.integer != integer) : !same_double(value->u.dbl, dbl))) {
+        printf("FAIL tree: %s is %.17g, expected %.17g\n", text,
+               (value == NULL) ? 0.0 : (value->type == json_integer) ? (double) value->u.integer : value->u.dbl,
+               (type == json_integer) ? (double) integer : dbl);
+        failures++;
+    }
+    json_value_free(value);
+
+    memset(&settings, 0, sizeof(settings));
+    memset(&handler, 0, sizeof(handler));
+    memset(&got, 0, sizeof(got));
+    handler.integer = got_integer;
+    handler.dbl = got_dbl;
+    handler.user_data = &got;
+    if (!json_sax_parse(&settings, &handler, (const json_char *) text, strlen(text), error) || (got.count != 1) ||
+        (got.type != type) || ((type == json_integer) ? (got.integer != integer) : !same_double(got.dbl, dbl))) {
+        printf("FAIL events: %s is %.17g, expected %.17g\n", text,
+               (got.type == json_integer) ? (double) got.integer : got.dbl, (type == json_integer) ? (double) integer : dbl);
+        failures++;
+    }
+
+    /* as the second of a pair, which is always a double */
+    snprintf(json, sizeof(json), "[[0, %s]]", text);
+    memset(&got, 0, sizeof(got));
+    handler.series = got_series;
+    if ((type == json_double) && (!json_sax_parse(&settings, &handler, (const json_char *) json, strlen(json), error) ||
+                                  (got.count != 1) || !same_double(got.dbl, dbl))) {
+        printf("FAIL series: %s is %.17g, expected %.17g\n", text, got.dbl, dbl);
+        failures++;
+    }
+}
+
+/* one without a fraction or an exponent is an integer when it fits, like strtoll makes of it */
+static void check_number (const char *text) {
+    long long integer;
+
+    if (strpbrk(text, ".eE") == NULL) {
+        errno = 0;
+        integer = strtoll(text, NULL, 10);
+        if (errno == 0) {
+            check(text, json_integer, integer, 0);
+            return;
+        }
+    }
+    check(text, json_double, 0, strtod(text, NULL));
+}
+
+/* a small generator of its own, so that a failure comes back on every run */
+static uint64_t random_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t next_random (void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return random_state;
+}
+
+int main (void) {
+    static const char *doubles[] = {
+        /* Clinger's fast path: the mantissa and the power of ten are both exact doubles */
+        "0.0", "-0.0", "1.5", "0.1", "3.14159", "-2.5e-3", "1e22", "1e-22", "9007199254740992e22", "123456789012345.6",
+        /* just past it, so Eisel-Lemire */
+        "1e23", "1e-23", "9007199254740993e0", "0.30000000000000004", "2.718281828459045e50", "7.3177701707893310e15",
+        "1.7976931348623157e64", "4.9e-64", "1e-64", "1e64", "1e65", "1e-65",
+        /* halfway between two doubles, rounded to even */
+        "9007199254740993.0", "9007199254740995.0", "4503599627370497.5", "4503599627370498.5", "9007199254740993e3",
+        "1.00000000000000011102230246251565404236316680908203125",
+        "1.00000000000000011102230246251565404236316680908203124",
+        "1.00000000000000011102230246251565404236316680908203126",
+        /* mantissas of 19 digits and more, the latter past what's accumulated */
+        "1234567890123456789e-30", "9999999999999999999.0", "9999999999999999999e-5", "1000000000000000000e3",
+        "12345678901234567890", "18446744073709551615.0", "18446744073709551616e0", "9223372036854775808",
+        "-9223372036854775809", "123456789012345678901234567890e-10", "0.1000000000000000055511151231257827021181583404541015625",
+        "3.000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000001",
+        /* subnormals and the smallest normal */
+        "4.9406564584124654e-324", "2.4703282292062327e-324", "2.4703282292062328e-324", "2.2250738585072011e-308",
+        "2.2250738585072014e-308", "1e-310", "-1e-320", "5e-324",
+        /* out of range both ways, and the largest double */
+        "1e400", "-1e400", "1e-400", "-1e-400", "1e99999999", "1.7976931348623157e308", "1.7976931348623158e308",
+        "1.7976931348623159e308",
+    };
+    char text[64];
+    double dbl;
+    size_t i;
+
+    for (i = 0; i < sizeof(doubles) / sizeof(doubles[0]); i++) {
+        check_number(doubles[i]);
+    }
+
+    /* the ends of json_int_t */
+    check("-9223372036854775808", json_integer, INT64_MIN, 0);
+    check("9223372036854775807", json_integer, INT64_MAX, 0);
+    check("0", json_integer, 0, 0);
+    check("-0", json_integer, 0, 0);
+
+    /* doubles printed back at full precision and less */
+    for (i = 0; i < 200000; i++) {
+        /* any bits but infinities and NaNs */
+        do {
+            uint64_t bits = next_random();
+
+            memcpy(&dbl, &bits, sizeof(dbl));
+        } while (dbl - dbl != 0);
+        snprintf(text, sizeof(text), (i % 3 == 0) ? "%.17g" : (i % 3 == 1) ? "%.15g" : "%.6e", dbl);
+        check_number(text);
+    }
+
+    /* decimals of up to 25 digits over the range of exponents, most of them past the fast paths */
+    for (i = 0; i < 200000; i++) {
+        uint64_t digits = next_random() % 25 + 1;
+        int length = 0;
+        uint64_t d;
+
+        for (d = 0; d < digits; d++) {
+            text[length++] = '0' + (d == 0 ? next_random() % 9 + 1 : next_random() % 10);
+        }
+        snprintf(&text[length], sizeof(text) - length, "e%d", (int) (next_random() % 700) - 350);
+        check_number(text);
+    }
+
+    if (failures > 0) {
+        printf("%d failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
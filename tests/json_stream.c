@@ -0,0 +1,222 @@
+/* decoding a document fed in pieces with json_sax_feed and json_sax_finish has to give the events that
+   json_sax_parse gives for all of it at once, wherever it's split and however small the pieces */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "../json.h"
+
+static int failures = 0;
+
+/* the events as text, one per line */
+struct log_t {
+    char *text;
+    size_t length;
+    size_t capacity;
+    int numbers;        /* integers and doubles alike, as the series' second member is always a double */
+};
+
+static int log_add (struct log_t *log, const char *format, ...) {
+    va_list args;
+    int length;
+
+    for (;;) {
+        va_start(args, format);
+        length = vsnprintf(&log->text[log->length], log->capacity - log->length, format, args);
+        va_end(args);
+        if ((size_t) length < log->capacity - log->length) {
+            break;
+        }
+        log->capacity = (log->capacity + length + 1) * 2;
+        log->text = realloc(log->text, log->capacity);
+        if (log->text == NULL) {
+            printf("error: malloc log\n");
+            exit(1);
+        }
+    }
+    log->length += length;
+    return 1;
+}
+
+static int on_object_begin (void *user_data) { return log_add(user_data, "{\n"); }
+static int on_object_end (void *user_data) { return log_add(user_data, "}\n"); }
+static int on_array_begin (void *user_data) { return log_add(user_data, "[\n"); }
+static int on_array_end (void *user_data) { return log_add(user_data, "]\n"); }
+static int on_boolean (int boolean, void *user_data) { return log_add(user_data, "b%d\n", boolean); }
+static int on_null (void *user_data) { return log_add(user_data, "null\n"); }
+
+static int on_key (const json_char *name, unsigned int length, void *user_data) {
+    return log_add(user_data, "k%u:%.*s\n", length, (int) length, (const char *) name);
+}
+
+static int on_string (const json_char *ptr, unsigned int length, void *user_data) {
+    return log_add(user_data, "s%u:%.*s\n", length, (int) length, (const char *) ptr);
+}
+
+static int on_integer (json_int_t integer, void *user_data) {
+    struct log_t *log = user_data;
+
+    return log_add(log, "%c%lld\n", log->numbers ? 'n' : 'i', (long long) integer);
+}
+
+static int on_dbl (double dbl, void *user_data) {
+    struct log_t *log = user_data;
+
+    return log_add(log, "%c%.17g\n", log->numbers ? 'n' : 'd', dbl);
+}
+
+/* a batch is logged as the pairs it stands for */
+static int on_series (const json_int_t *first, const double *second, size_t count, void *user_data) {
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        log_add(user_data, "[\nn%lld\nn%.17g\n]\n", (long long) first[i], second[i]);
+    }
+    return 1;
+}
+
+static void handler_init (json_sax_handler *handler, struct log_t *log, int series) {
+    memset(handler, 0, sizeof(*handler));
+    handler->object_begin = on_object_begin;
+    handler->object_end = on_object_end;
+    handler->array_begin = on_array_begin;
+    handler->array_end = on_array_end;
+    handler->key = on_key;
+    handler->string = on_string;
+    handler->integer = on_integer;
+    handler->dbl = on_dbl;
+    handler->boolean = on_boolean;
+    handler->null = on_null;
+    handler->series = series ? on_series : NULL;
+    handler->user_data = log;
+    log->length = 0;
+    log->numbers = series;
+    log_add(log, "%s", "");
+}
+
+/* feeds the document in pieces that end at each of the stops, the unconsumed rest going again at the front of the next.
+   returns 1 if the stream took it all */
+static int feed (json_sax_handler *handler, const char *json, size_t length, const size_t *stops, size_t num_stops,
+                 char *error) {
+    json_settings settings;
+    json_sax_stream *stream;
+    size_t start = 0;
+    size_t consumed;
+    size_t i;
+    int ok = 1;
+
+    memset(&settings, 0, sizeof(settings));
+    stream = json_sax_stream_new(&settings, handler);
+    if (stream == NULL) {
+        strcpy(error, "json_sax_stream_new");
+        return 0;
+    }
+    for (i = 0; (i < num_stops) && ok; i++) {
+        ok = json_sax_feed(stream, (const json_char *) &json[start], stops[i] - start, &consumed, error);
+        start += consumed;
+    }
+    if (ok) {
+        ok = json_sax_finish(stream, (const json_char *) &json[start], length - start, error);
+    }
+    json_sax_stream_free(stream);
+
+    return ok;
+}
+
+/* the document split at every offset and fed a byte at a time, with the series fast path and without */
+static void check (const char *name, const char *json, size_t length) {
+    json_settings settings;
+    json_sax_handler handler;
+    struct log_t whole;
+    struct log_t pieces;
+    size_t *stops;
+    size_t split;
+    char error[json_error_max];
+    int series;
+    int ok;
+
+    memset(&whole, 0, sizeof(whole));
+    memset(&pieces, 0, sizeof(pieces));
+    memset(&settings, 0, sizeof(settings));
+    stops = malloc(sizeof(size_t) * (length + 1));
+    if (stops == NULL) {
+        printf("error: malloc stops\n");
+        exit(1);
+    }
+    for (split = 0; split <= length; split++) {
+        stops[split] = split;
+    }
+
+    for (series = 0; series <= 1; series++) {
+        handler_init(&handler, &whole, series);
+        ok = json_sax_parse(&settings, &handler, (const json_char *) json, length, error);
+
+        for (split = 0; split <= length; split++) {
+            handler_init(&handler, &pieces, series);
+            if ((feed(&handler, json, length, &stops[split], 1, error) != ok) ||
+                (ok && ((pieces.length != whole.length) || (memcmp(pieces.text, whole.text, whole.length) != 0)))) {
+                printf("FAIL %s%s: split at %zu %s\n", name, series ? " with series" : "", split, ok ? "differs" : "was taken");
+                failures++;
+                break;
+            }
+        }
+
+        handler_init(&handler, &pieces, series);
+        if ((feed(&handler, json, length, stops, length + 1, error) != ok) ||
+            (ok && ((pieces.length != whole.length) || (memcmp(pieces.text, whole.text, whole.length) != 0)))) {
+            printf("FAIL %s%s: a byte at a time %s\n", name, series ? " with series" : "", ok ? "differs" : "was taken");
+            failures++;
+        }
+    }
+
+    free(stops);
+    free(whole.text);
+    free(pieces.text);
+}
+
+int main (void) {
+    static const char *documents[] = {
+        "{}", "[]", "0", "-1.5e3", "\"\"", "true", "false", "null", "  [ ]  ", "123456789", "1.25e-300",
+        "{\"a\": 1, \"b\": [true, false, null], \"c\": {\"d\": \"e\", \"f\": []}, \"g\": -0.0}",
+        "[[[[[[[[[[[[[[[[[[[[1]]]]]]]]]]]]]]]]]]]]",
+        "[\"tab\\there\", \"quote\\\" and \\\\ slash\\/\", \"\\u00e9\\u20ac\\ud83d\\ude00\", \"\\b\\f\\n\\r\"]",
+        "{\"long key 0123456789012345678901234567890123456789\": \"0123456789012345678901234567890123456789012345678901234567890123\"}",
+        "\xEF\xBB\xBF{\"bom\": true}",
+        "[1, 2,]",
+        "{\"prices\": [[1609459200000, 24000.5], [1609462800000, 24100], [1609466400000, 2.41e4]],\n"
+        " \"market_caps\": [[1609459200000, 445000000000], [1609462800000, 4.46e11]],\n"
+        " \"total_volumes\": [[1609459200000, 1.5], \"odd one\", [1, 2, 3], [1.5, 2], [1609466400000, -3]]}",
+        /* broken ones */
+        "[", "{\"a\"}", "[1,,]", "[01]", "[1.]", "\"unterminated", "[\"\\x\"]", "[true false]", "{\"a\": [1, 2}", "[1] 2",
+        "nul", "[[1, ]]", "[[1 2]]",
+    };
+    char *big;
+    size_t length;
+    size_t i;
+
+    for (i = 0; i < sizeof(documents) / sizeof(documents[0]); i++) {
+        check(documents[i], documents[i], strlen(documents[i]));
+    }
+
+    /* a response as the API sends it, the pieces cut across the pairs in every way */
+    big = malloc(200 * 48 + 64);
+    if (big == NULL) {
+        printf("error: malloc\n");
+        return 1;
+    }
+    length = sprintf(big, "{\"prices\":[");
+    for (i = 0; i < 200; i++) {
+        length += sprintf(&big[length], "%s[%llu,%.10g]", i ? "," : "", 1609459200000ULL + i * 3600000ULL, 20000 + i * 1.37);
+    }
+    length += sprintf(&big[length], "]}");
+    check("200 hourly pairs", big, length);
+    free(big);
+
+    if (failures > 0) {
+        printf("%d failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
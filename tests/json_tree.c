@@ -0,0 +1,141 @@
+/* the tree json_single_pass builds has to be the same as the one of the two passes, value for value,
+   and a document one of them refuses the other has to refuse too */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../json.h"
+
+static int failures = 0;
+
+/* returns 1 if the trees are the same, down to the bits of the doubles and the order of the object entries */
+static int same_tree (const json_value *a, const json_value *b) {
+    unsigned int i;
+
+    if (a->type != b->type) {
+        return 0;
+    }
+    switch (a->type) {
+    case json_object:
+        if (a->u.object.length != b->u.object.length) {
+            return 0;
+        }
+        for (i = 0; i < a->u.object.length; i++) {
+            if ((a->u.object.values[i].name_length != b->u.object.values[i].name_length) ||
+                (memcmp(a->u.object.values[i].name, b->u.object.values[i].name, a->u.object.values[i].name_length + 1) != 0) ||
+                (a->u.object.values[i].value->parent != a) || (b->u.object.values[i].value->parent != b) ||
+                !same_tree(a->u.object.values[i].value, b->u.object.values[i].value)) {
+                return 0;
+            }
+        }
+        return 1;
+    case json_array:
+        if (a->u.array.length != b->u.array.length) {
+            return 0;
+        }
+        for (i = 0; i < a->u.array.length; i++) {
+            if ((a->u.array.values[i]->parent != a) || (b->u.array.values[i]->parent != b) ||
+                !same_tree(a->u.array.values[i], b->u.array.values[i])) {
+                return 0;
+            }
+        }
+        return 1;
+    case json_integer:
+        return a->u.integer == b->u.integer;
+    case json_double:
+        return memcmp(&a->u.dbl, &b->u.dbl, sizeof(double)) == 0;
+    case json_string:
+        return (a->u.string.length == b->u.string.length) &&
+               (memcmp(a->u.string.ptr, b->u.string.ptr, a->u.string.length + 1) == 0);
+    case json_boolean:
+        return a->u.boolean == b->u.boolean;
+    default:
+        return 1;
+    }
+}
+
+/* parses the document both ways with the given settings, they have to agree */
+static void check (const char *name, const char *json, size_t length, int settings) {
+    json_settings two_pass;
+    json_settings single_pass;
+    json_value *a;
+    json_value *b;
+    char error_a[json_error_max];
+    char error_b[json_error_max];
+
+    memset(&two_pass, 0, sizeof(two_pass));
+    two_pass.settings = settings;
+    single_pass = two_pass;
+    single_pass.settings |= json_single_pass;
+
+    a = json_parse_ex(&two_pass, (const json_char *) json, length, error_a);
+    b = json_parse_ex(&single_pass, (const json_char *) json, length, error_b);
+    if ((a == NULL) != (b == NULL)) {
+        printf("FAIL %s: %s\n", name, (a == NULL) ? error_a : error_b);
+        failures++;
+    } else if ((a != NULL) && ((a->parent != NULL) || (b->parent != NULL) || !same_tree(a, b))) {
+        printf("FAIL %s: the trees differ\n", name);
+        failures++;
+    }
+    json_value_free(a);
+    json_value_free(b);
+}
+
+int main (void) {
+    static const char *documents[] = {
+        "{}", "[]", "0", "-1.5e3", "\"\"", "true", "false", "null", "  [ ]  ",
+        "{\"a\": 1, \"b\": [true, false, null], \"c\": {\"d\": \"e\", \"f\": []}, \"g\": -0.0}",
+        "[[[[[[[[[[[[[[[[[[[[1]]]]]]]]]]]]]]]]]]]]",
+        "[{}, {\"\": {}}, [[]], [{}, []], {\"x\": [{}]}]",
+        "{\"a\": 1, \"a\": 2, \"a\": [3]}",
+        "[\"tab\\there\", \"quote\\\" and \\\\ slash\\/\", \"\\u00e9\\u20ac\\ud83d\\ude00\", \"\\b\\f\\n\\r\"]",
+        "{\"k\\u00e9y\": \"v\\u0000al\", \"long\": \"0123456789012345678901234567890123456789012345678901234567890123\"}",
+        "[1, -1, 9223372036854775807, -9223372036854775808, 9223372036854775808, 1e400, 5e-324, 0.1, 12345678901234567890]",
+        "\xEF\xBB\xBF{\"bom\": true}",
+        "{\"prices\": [[1609459200000, 24000.5], [1609462800000, 24100], [1609466400000, 2.41e4]], \"total_volumes\": []}",
+        /* broken ones */
+        "", "[", "{\"a\"}", "[1,]", "{\"a\": 1,}", "[01]", "[1.]", "[1e]", "\"unterminated", "[\"\\x\"]", "[true false]",
+        "{\"a\": [1, 2}", "[1] 2", "nul", "[-]", "{1: 2}",
+    };
+    static const char *commented[] = {
+        "// a comment\n[1, /* two */ 2]", "{\"a\": /* x */ 1} // end", "[1, 2 /* unterminated", "/ [1]",
+    };
+    char *big;
+    size_t length;
+    size_t i;
+
+    for (i = 0; i < sizeof(documents) / sizeof(documents[0]); i++) {
+        check(documents[i], documents[i], strlen(documents[i]), 0);
+    }
+    for (i = 0; i < sizeof(commented) / sizeof(commented[0]); i++) {
+        check(commented[i], commented[i], strlen(commented[i]), json_enable_comments);
+        check(commented[i], commented[i], strlen(commented[i]), 0);
+    }
+    /* a nul in the middle ends neither */
+    check("nul inside", "[1, \0 2]", 8, 0);
+
+    /* a response of a year of hourly pairs, as the API sends it */
+    big = malloc(3 * 8760 * 48 + 64);
+    if (big == NULL) {
+        printf("error: malloc\n");
+        return 1;
+    }
+    length = sprintf(big, "{\"prices\":[");
+    for (i = 0; i < 8760; i++) {
+        length += sprintf(&big[length], "%s[%llu,%.10g]", i ? "," : "", 1609459200000ULL + i * 3600000ULL, 20000 + i * 1.37);
+    }
+    length += sprintf(&big[length], "],\"market_caps\":[");
+    for (i = 0; i < 8760; i++) {
+        length += sprintf(&big[length], "%s[%llu,%llu]", i ? "," : "", 1609459200000ULL + i * 3600000ULL, 400000000000ULL + i);
+    }
+    length += sprintf(&big[length], "],\"total_volumes\":[]}");
+    check("a year of hourly pairs", big, length, 0);
+    free(big);
+
+    if (failures > 0) {
+        printf("%d failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
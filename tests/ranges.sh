@@ -0,0 +1,18 @@
+#!/bin/sh
+# a range that ends before it begins is refused before anything is allocated or fetched
+moneymaker=$(realpath "$1")
+failed=0
+
+out=$("$moneymaker" bitcoin 2021-01-10 2021-01-01 2>&1)
+if [ $? -eq 0 ] || ! echo "$out" | grep -q "error: end date is before begin date"; then
+    echo "FAIL: reversed range wasn't refused: $out"
+    failed=1
+fi
+
+out=$(echo "bitcoin 2021-01-10 2021-01-01" | "$moneymaker" -b - 2>&1)
+if ! echo "$out" | grep -q "error: end date is before begin date"; then
+    echo "FAIL: reversed range in a batch wasn't refused: $out"
+    failed=1
+fi
+
+exit $failed
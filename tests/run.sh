@@ -0,0 +1,24 @@
+#!/bin/sh
+# builds the program and the tests into tests/build and runs them all. exits 1 if any fails
+cd "$(dirname "$0")/.." || exit 1
+mkdir -p tests/build
+gcc -Wall timedate.c curl_helpers.c json.c series.c cache.c bars.c main.c -o tests/build/moneymaker -lm -lcurl || exit 1
+
+failed=0
+# the tests in C are built with everything but main.c
+for test in tests/*.c; do
+    [ -e "$test" ] || continue
+    echo "$test"
+    name=tests/build/$(basename "$test" .c)
+    if ! gcc -Wall "$test" timedate.c curl_helpers.c json.c series.c cache.c bars.c -o "$name" -lm -lcurl || ! "$name"; then
+        failed=1
+    fi
+done
+for test in tests/*.sh; do
+    [ "$test" = "tests/run.sh" ] && continue
+    echo "$test"
+    sh "$test" tests/build/moneymaker || failed=1
+done
+
+[ $failed -eq 0 ] && echo "all tests passed"
+exit $failed
@@ -0,0 +1,34 @@
+#!/bin/sh
+# overlapping batch queries of a coin are fetched once, as a superset that goes in the turn of the first of them,
+# so the records of a batch that's replayed come in the order the coins are listed
+moneymaker=$(realpath "$1")
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+failed=0
+
+# record coin from to: hourly pairs from from to to, both included
+record() {
+    python3 - "$tmp/$1-eur-$2-$3.json" "$2" "$3" <<'PY'
+import json, sys
+begin, end = int(sys.argv[2]), int(sys.argv[3])
+pairs = {"prices": [], "market_caps": [], "total_volumes": []}
+for t in range(begin, end + 1, 3600):
+    pairs["prices"].append([t * 1000, 100 + (t // 86400) % 7])
+    pairs["market_caps"].append([t * 1000, 1000])
+    pairs["total_volumes"].append([t * 1000, 10])
+json.dump(pairs, open(sys.argv[1], "w"))
+PY
+}
+
+# monero for 2021-01, bitcoin for the superset of 2021-01 and 2021-01-15 to 2021-03-01
+record monero 1609459200 1612141200
+record bitcoin 1609459200 1614560400
+
+order=$(printf "monero 2021-01-01 2021-02-01\nbitcoin 2021-01-01 2021-02-01\nbitcoin 2021-01-15 2021-03-01\n" |
+        "$moneymaker" -P "$tmp" -b - 2>/dev/null | cut -f 1 | tr '\n' ' ')
+if [ "$order" != "monero bitcoin bitcoin " ]; then
+    echo "FAIL: records in the order '$order'"
+    failed=1
+fi
+
+exit $failed
@@ -6,49 +6,73 @@
 
 static uint8_t days_in_month[12] = {31,28,31,30,31,30,31,31,30,31,30,31};
 
-int8_t add_days_to_date(struct date_yyyymmdd_t *date, struct date_yyyymmdd_t *output, uint16_t add_days) {
-    if (date == NULL) {
-        printf("error: date is missing\n");
-        return 0;
+/* days since 1970-01-01 of a date in the proleptic gregorian calendar, in constant time.
+   years are counted from march so that the leap day is the last of the year, and in 400 year eras that repeat */
+int64_t days_from_civil(int64_t year, uint32_t month, uint32_t day) {
+    int64_t era;
+    int64_t year_of_era;
+    int64_t day_of_year;
+    int64_t day_of_era;
+    
+    year -= (month <= 2);
+    era = (year >= 0 ? year : year - 399) / 400;
+    year_of_era = year - era * 400;                                             /* [0, 399] */
+    day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;  /* [0, 365] */
+    day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;  /* [0, 146096] */
+    
+    return era * 146097 + day_of_era - 719468;
+}
+
+/* the date of a day since 1970-01-01, the inverse of days_from_civil */
+void civil_from_days(int64_t days, struct date_yyyymmdd_t *date) {
+    int64_t era;
+    int64_t day_of_era;
+    int64_t year_of_era;
+    int64_t day_of_year;
+    int64_t month_index;
+    
+    days += 719468;
+    era = (days >= 0 ? days : days - 146096) / 146097;
+    day_of_era = days - era * 146097;                                                           /* [0, 146096] */
+    year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;   /* [0, 399] */
+    day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);        /* [0, 365] */
+    month_index = (5 * day_of_year + 2) / 153;                                                  /* [0, 11], from march */
+    
+    date->day = day_of_year - (153 * month_index + 2) / 5 + 1;
+    date->month = month_index < 10 ? month_index + 3 : month_index - 9;
+    date->year = year_of_era + era * 400 + (date->month <= 2);
+}
+
+/* the dates of many timestamps at once, e.g. to label a series. no loops or branches per element, so it vectorizes */
+void timestamps_to_dates(const int64_t *timestamps, struct date_yyyymmdd_t *dates, size_t count) {
+    int64_t days;
+    size_t i;
+    
+    for (i = 0; i < count; i++) {
+        /* rounded down, also before 1970 */
+        days = timestamps[i] / (24*60*60);
+        days -= (timestamps[i] % (24*60*60)) < 0;
+        civil_from_days(days, &dates[i]);
     }
-    
-    output->year = 1970;
-    output->month = 1;
-    output->day = 1;
-    
-    uint8_t done = 0;
-    
-    int64_t timestamp = get_timestamp(date);
+}
 
-    uint16_t days = add_days + (timestamp / (24*60*60));
-    
-    uint16_t days_in_a_year = 0;    
+/* the timestamps of many dates at once, at their midnight */
+void dates_to_timestamps(const struct date_yyyymmdd_t *dates, int64_t *timestamps, size_t count) {
+    size_t i;
     
-    while (!done) {
-        days_in_a_year = (365 + is_leap_year(output->year));
-        if (days >= days_in_a_year) {
-            days -= days_in_a_year;
-            output->year++;
-        } else if (days >= days_in_month[output->month - 1]) {
-            if ((output->month == 2) && (days_in_a_year == 366)) {
-                if (days >= 29) {
-                    output->month++;
-                    days -= 29;
-                } else {
-                    done = 1;
-                    output->day += days;
-                }
-            } else {
-                days -= days_in_month[output->month - 1];                           
-                output->month++;
-            }
-            
-        } else {
-            done = 1;
-            output->day += days;
-        }
+    for (i = 0; i < count; i++) {
+        timestamps[i] = days_from_civil(dates[i].year, dates[i].month, dates[i].day) * (24*60*60);
+    }
+}
+
+int8_t add_days_to_date(struct date_yyyymmdd_t *date, struct date_yyyymmdd_t *output, size_t add_days) {
+    if (date == NULL) {
+        fprintf(stderr, "error: date is missing\n");
+        return 0;
     }
     
+    civil_from_days(days_from_civil(date->year, date->month, date->day) + add_days, output);
+    
 #ifdef DEBUG            
             printf("date: %04d-%02d-%02d\t%15lld\n", output->year, output->month, output->day, get_timestamp(output));
 #endif  
@@ -77,23 +101,23 @@ uint8_t is_valid_date(struct date_yyyymmdd_t *date) {
         if (is_leap_year(date->year)) {
             return 1;
         } else {
-            printf("error: that's not a leap year!\n");
+            fprintf(stderr, "error: that's not a leap year!\n");
             return 0;
         }
     } else if ((date->day < 1) || (date->day > days_in_month[date->month - 1])) {
-        printf("error: invalid day.\n");
+        fprintf(stderr, "error: invalid day.\n");
         return 0;
     } else if ((date->month < 1) || (date->month > 12)) {
-        printf("error: invalid month.\n");
+        fprintf(stderr, "error: invalid month.\n");
         return 0;
     } else if (date->year < 2013) {
-        printf("error: no records before 2013-04-28\n");
+        fprintf(stderr, "error: no records before 2013-04-28\n");
         return 0;
     } else if ((date->year == 2013) && (date->month < 4)) {
-        printf("error: no records before 2013-04-28\n");
+        fprintf(stderr, "error: no records before 2013-04-28\n");
         return 0;
     } else if ((date->year == 2013) && (date->month == 4) && (date->day < 28)) {
-        printf("error: no records before 2013-04-28\n");
+        fprintf(stderr, "error: no records before 2013-04-28\n");
         return 0;
     } else if (date_is_in_the_future) {
         /*
@@ -101,7 +125,7 @@ uint8_t is_valid_date(struct date_yyyymmdd_t *date) {
          *  convert current system time/date to UTC before checking against
          *  requires timezone and offset and so on... luckily the software works without it
          */
-        printf("error: date can't be in the future (UTC)\n");
+        fprintf(stderr, "error: date can't be in the future (UTC)\n");
         return 0;
     }
 
@@ -109,29 +133,12 @@ uint8_t is_valid_date(struct date_yyyymmdd_t *date) {
 }
 
 int64_t get_timestamp (struct date_yyyymmdd_t *date) {
-    uint32_t days = 0;
+    int64_t days = days_from_civil(date->year, date->month, date->day);
     int64_t timestamp;
     
-    for (uint32_t year = 1970; year < date->year; year++) {
-        days += 365 + is_leap_year(year);
-    }
-    
-    if (date->month > 1) {
-        for (uint8_t i = 0; i < date->month - 1; i++) {
-            days += days_in_month[i];
-        }
-    }
-    days += date->day - 1;
-    
-    if (is_leap_year(date->year)) {
-        if ((date->month > 2) || ((date->month == 2) && (date->month >= 29))) {
-            days++;
-        }
-    }
-    
     timestamp = days * (60*60*24);
 #if DEBUG   
-    printf("%d days timestamp: %15lld\n", days, timestamp);
+    printf("%lld days timestamp: %15lld\n", days, timestamp);
 #endif  
     return timestamp;
 }
@@ -140,10 +147,10 @@ uint32_t days_between(struct date_yyyymmdd_t *date_begin, struct date_yyyymmdd_t
     uint32_t days = 0;
 
     if (is_valid_date(date_begin) == 0) {
-        printf("error: date_begin is invalid\n");
+        fprintf(stderr, "error: date_begin is invalid\n");
         return 0;
     } else if (is_valid_date(date_end) == 0) {
-        printf("error: date_end is invalid\n");
+        fprintf(stderr, "error: date_end is invalid\n");
         return 0;
     }
     
@@ -156,7 +163,7 @@ uint32_t days_between(struct date_yyyymmdd_t *date_begin, struct date_yyyymmdd_t
 
 int8_t parse_date(const char *str, struct date_yyyymmdd_t *date) {
     if (sscanf(str, "%u-%u-%u", &(date->year), &(date->month), &(date->day)) != 3) {
-        printf("error parsing date. the correct format is: yyyy-mm-dd e.g. 2021-1-01\n");
+        fprintf(stderr, "error parsing date. the correct format is: yyyy-mm-dd e.g. 2021-1-01\n");
         return 0;
     }
     
@@ -4,7 +4,11 @@ struct date_yyyymmdd_t {
   uint32_t day;
 };
 
-int8_t add_days_to_date(struct date_yyyymmdd_t *date, struct date_yyyymmdd_t *output, uint16_t add_days);
+int64_t days_from_civil(int64_t year, uint32_t month, uint32_t day);
+void civil_from_days(int64_t days, struct date_yyyymmdd_t *date);
+void timestamps_to_dates(const int64_t *timestamps, struct date_yyyymmdd_t *dates, size_t count);
+void dates_to_timestamps(const struct date_yyyymmdd_t *dates, int64_t *timestamps, size_t count);
+int8_t add_days_to_date(struct date_yyyymmdd_t *date, struct date_yyyymmdd_t *output, size_t add_days);
 uint8_t is_leap_year(int year);
 uint8_t is_valid_date(struct date_yyyymmdd_t *date);
 int64_t get_timestamp (struct date_yyyymmdd_t *date);